@@ -1,23 +1,71 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <stack>
+#include <deque>
 #include <queue>
 #include <fstream>
 #include <sstream>
 #include <ctime>
+#include <cstdio>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <array>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <filesystem>
+#include <climits>
+#include <optional>
+#include <cerrno>
+#include <cstdlib>
+#include <cctype>
+#include <string_view>
 using namespace std;
 
 // All used data are AI-generated and for educational purpose only !
 const string PATIENT_FILE = "patients.csv";
 const string DOCTOR_FILE = "doctors.csv";
-
+const string APPOINTMENT_FILE = "appointments.csv";
+
+// Medical history tiering: only the most recent records stay in memory,
+// older ones are spilled in blocks to a per patient-range archive file.
+// Like the in-memory history, the archive only lasts for the current session.
+const int HISTORY_HOT_LIMIT = 64;
+const int HISTORY_BLOCK_SIZE = 32;
+const int PATIENTS_PER_ARCHIVE = 1000;
+
+// Lab pipeline: worker threads performing requested tests hospital-wide.
+const int LAB_WORKERS = 4;
+
+// Event sourcing: every Hospital operation is appended to the event log;
+// replays store a checkpoint of the rebuilt state every CHECKPOINT_INTERVAL events.
+const string EVENT_FILE = "events.log";
+const string CHECKPOINT_FILE = "events.ckpt";
+const long long CHECKPOINT_INTERVAL = 1000000;
+
+// Lazy loading: patients are only indexed at startup and read from the CSV
+// on first access; the index of IDs in file order is kept between runs,
+// together with the highest ID ever issued.
+const bool LAZY_PATIENT_LOADING = true;
+const string PATIENT_INDEX_FILE = "patients.idx";
+
+// Thread-safe: lab workers timestamp completed tests while the main thread runs.
 string getCurrentDateTime()
 {
     time_t now = time(0);
     char buffer[80];
-    tm *ltm = localtime(&now);
-    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", ltm);
+    tm ltm;
+#ifdef _WIN32
+    localtime_s(&ltm, &now);
+#else
+    localtime_r(&now, &ltm);
+#endif
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &ltm);
     return string(buffer);
 }
 
@@ -29,7 +77,8 @@ enum Department
     ORTHOPEDICS,
     PEDIATRICS,
     EMERGENCY,
-    GENERAL
+    GENERAL,
+    DEPARTMENT_COUNT
 };
 
 enum RoomType
@@ -37,9 +86,409 @@ enum RoomType
     GENERAL_WARD,
     ICU,
     PRIVATE_ROOM,
-    SEMI_PRIVATE
+    SEMI_PRIVATE,
+    ROOM_TYPE_COUNT
+};
+
+// ========== ENUM METADATA ========== //
+// Name tables for the enums, checked at compile time. String-to-enum lookups
+// go through a perfect hash (seed searched at compile time), so parsing a
+// CSV field costs one hash and a single string comparison.
+template <typename E>
+struct EnumTraits;
+
+template <>
+struct EnumTraits<Department>
+{
+    static constexpr int count = DEPARTMENT_COUNT;
+    static constexpr const char *names[count] = {"Cardiology", "Neurology", "Orthopedics", "Pediatrics", "Emergency", "General"};
+};
+
+template <>
+struct EnumTraits<RoomType>
+{
+    static constexpr int count = ROOM_TYPE_COUNT;
+    static constexpr const char *names[count] = {"General Ward", "ICU", "Private Room", "Semi-Private Room"};
+};
+
+constexpr unsigned int fnv1a(string_view text, unsigned int seed)
+{
+    unsigned int hash = 2166136261u ^ seed;
+    for (char c : text)
+    {
+        hash = (hash ^ (unsigned char)c) * 16777619u;
+    }
+    return hash;
+}
+
+template <typename E>
+class EnumTable
+{
+private:
+    static constexpr int slotCount = 16;
+    static_assert(EnumTraits<E>::count * 2 <= slotCount, "Enum too large for its hash table");
+
+    struct PerfectHash
+    {
+        unsigned int seed;
+        array<int, slotCount> slots; // Enum value per slot, -1 when empty
+    };
+
+    static constexpr bool namesComplete()
+    {
+        for (int i = 0; i < EnumTraits<E>::count; i++)
+        {
+            if (EnumTraits<E>::names[i] == nullptr || EnumTraits<E>::names[i][0] == '\0')
+                return false;
+        }
+        return true;
+    }
+
+    static constexpr PerfectHash build()
+    {
+        for (unsigned int seed = 1; seed < 100000; seed++)
+        {
+            PerfectHash table = {seed, {}};
+            for (int &slot : table.slots)
+                slot = -1;
+
+            bool collision = false;
+            for (int i = 0; i < EnumTraits<E>::count && !collision; i++)
+            {
+                int &slot = table.slots[fnv1a(EnumTraits<E>::names[i], seed) % slotCount];
+                collision = slot != -1;
+                slot = i;
+            }
+            if (!collision)
+                return table;
+        }
+        return {0, {}};
+    }
+
+    static_assert(namesComplete(), "Every enum value needs a name");
+    static constexpr PerfectHash table = build();
+    static_assert(table.seed != 0, "No perfect hash seed found for enum names");
+
+public:
+    static constexpr int count = EnumTraits<E>::count;
+
+    static constexpr const char *name(E value)
+    {
+        return (value >= 0 && value < count) ? EnumTraits<E>::names[value] : "Unknown";
+    }
+
+    static constexpr E parse(string_view text, E fallback)
+    {
+        int value = table.slots[fnv1a(text, table.seed) % slotCount];
+        return (value != -1 && text == EnumTraits<E>::names[value]) ? static_cast<E>(value) : fallback;
+    }
+
+    // Maps a choice from the printMenu() menu to its value; false outside the menu.
+    static constexpr bool fromMenu(int choice, E &value)
+    {
+        if (choice < 0 || choice >= count)
+            return false;
+        value = static_cast<E>(choice);
+        return true;
+    }
+
+    // Prints "index. name" lines for a selection menu.
+    static void printMenu()
+    {
+        for (int i = 0; i < count; i++)
+        {
+            cout << i << ". " << EnumTraits<E>::names[i] << "\n";
+        }
+    }
 };
 
+// Every name must map back to its own value through the hash table.
+template <typename E>
+constexpr bool enumRoundTrips()
+{
+    for (int i = 0; i < EnumTable<E>::count; i++)
+    {
+        if (EnumTable<E>::parse(EnumTable<E>::name(static_cast<E>(i)), static_cast<E>(EnumTable<E>::count)) != i)
+            return false;
+    }
+    return true;
+}
+
+// The menus accept exactly the indices printMenu() shows, each mapping to its named value.
+template <typename E>
+constexpr bool menuRangeValid()
+{
+    E value = static_cast<E>(0);
+    for (int choice = -1; choice <= EnumTable<E>::count; choice++)
+    {
+        bool shown = choice >= 0 && choice < EnumTable<E>::count;
+        if (EnumTable<E>::fromMenu(choice, value) != shown || (shown && value != choice))
+            return false;
+    }
+    return true;
+}
+
+static_assert(enumRoundTrips<Department>(), "Department name table is inconsistent");
+static_assert(enumRoundTrips<RoomType>(), "RoomType name table is inconsistent");
+static_assert(menuRangeValid<Department>(), "Department menu range does not match its table");
+static_assert(menuRangeValid<RoomType>(), "RoomType menu range does not match its table");
+
+// ========== HISTORY ARCHIVE ========== //
+// Compact, append-only block storage for older medical records.
+// Block layout: [patientId][recordCount][payloadSize] (u32 each) + payload.
+// Payload: a dictionary of event texts, then one entry per record (oldest
+// first) holding the dictionary code and the delta-encoded timestamp.
+
+// Days since 1970-01-01 for a civil date (proleptic Gregorian calendar).
+long long daysFromCivil(long long y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    long long era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (long long)doe - 719468;
+}
+
+// Parses "YYYY-MM-DD HH:MM:SS" (as produced by getCurrentDateTime) into seconds.
+bool parseDateTime(const string &text, long long &seconds)
+{
+    int y, mo, d, h, mi, s;
+    char tail;
+    if (text.size() != 19 || sscanf(text.c_str(), "%4d-%2d-%2d %2d:%2d:%2d%c", &y, &mo, &d, &h, &mi, &s, &tail) != 6)
+        return false;
+    if (mo < 1 || mo > 12 || d < 1 || d > 31 || h > 23 || mi > 59 || s > 60)
+        return false;
+
+    seconds = daysFromCivil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s;
+    return true;
+}
+
+string formatDateTime(long long seconds)
+{
+    long long z = (seconds >= 0 ? seconds : seconds - 86399) / 86400;
+    long long secs = seconds - z * 86400;
+    z += 719468;
+    long long era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    unsigned d = doy - (153 * mp + 2) / 5 + 1;
+    unsigned m = mp < 10 ? mp + 3 : mp - 9;
+    long long y = (long long)yoe + era * 400 + (m <= 2);
+
+    char buffer[80];
+    snprintf(buffer, sizeof(buffer), "%04lld-%02u-%02u %02lld:%02lld:%02lld",
+             y, m, d, secs / 3600, (secs / 60) % 60, secs % 60);
+    return string(buffer);
+}
+
+// Current time in the seconds used by event and appointment timestamps.
+long long currentTimestamp()
+{
+    long long seconds = 0;
+    parseDateTime(getCurrentDateTime(), seconds);
+    return seconds;
+}
+
+void putVarint(string &out, unsigned long long value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((char)((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+bool getVarint(const string &in, size_t &pos, unsigned long long &value)
+{
+    value = 0;
+    for (int shift = 0; pos < in.size() && shift < 64; shift += 7)
+    {
+        unsigned char byte = (unsigned char)in[pos++];
+        value |= (unsigned long long)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+void putU32(string &out, unsigned int value)
+{
+    for (int i = 0; i < 4; i++)
+        out.push_back((char)((value >> (8 * i)) & 0xFF));
+}
+
+unsigned int getU32(const char *in)
+{
+    unsigned int value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= (unsigned int)(unsigned char)in[i] << (8 * i);
+    return value;
+}
+
+void putU64(string &out, unsigned long long value)
+{
+    for (int i = 0; i < 8; i++)
+        out.push_back((char)((value >> (8 * i)) & 0xFF));
+}
+
+unsigned long long getU64(const char *in)
+{
+    unsigned long long value = 0;
+    for (int i = 0; i < 8; i++)
+        value |= (unsigned long long)(unsigned char)in[i] << (8 * i);
+    return value;
+}
+
+void putSigned(string &out, long long value)
+{
+    putVarint(out, ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63));
+}
+
+bool getSigned(const string &in, size_t &pos, long long &value)
+{
+    unsigned long long zigzag;
+    if (!getVarint(in, pos, zigzag))
+        return false;
+    value = (long long)(zigzag >> 1) ^ -(long long)(zigzag & 1);
+    return true;
+}
+
+void putString(string &out, const string &text)
+{
+    putVarint(out, text.size());
+    out += text;
+}
+
+bool getString(const string &in, size_t &pos, string &text)
+{
+    unsigned long long length;
+    if (!getVarint(in, pos, length) || length > in.size() - pos)
+        return false;
+    text = in.substr(pos, length);
+    pos += length;
+    return true;
+}
+
+// Archive file holding the history blocks for a range of patient IDs.
+string historyArchiveFile(int patientId)
+{
+    int first = ((patientId - 1) / PATIENTS_PER_ARCHIVE) * PATIENTS_PER_ARCHIVE + 1;
+    return "history_" + to_string(first) + "_" + to_string(first + PATIENTS_PER_ARCHIVE - 1) + ".dat";
+}
+
+// Appends one encoded block and returns its offset in the archive, or -1 on failure.
+// Hot history is not persisted across runs, so each archive is restarted the
+// first time it is written in a session: archives are session scratch space,
+// not a long-term store, and their block offsets are only kept in memory.
+long long appendHistoryBlock(int patientId, const vector<string> &records)
+{
+    static set<string> sessionArchives;
+
+    string path = historyArchiveFile(patientId);
+    bool fresh = sessionArchives.insert(path).second;
+    ofstream file(path, ios::binary | (fresh ? ios::trunc : ios::app));
+    if (!file.is_open())
+    {
+        cerr << "Error: Could not open " << path << " for writing.\n";
+        return -1;
+    }
+
+    vector<string> dictionary;
+    string payload, codes;
+    long long previous = 0;
+    for (const string &record : records)
+    {
+        // Records look like "<event> on <date time>"; the timestamp is split off.
+        string event = record;
+        long long seconds = 0;
+        size_t split = record.rfind(" on ");
+        bool hasTime = split != string::npos && parseDateTime(record.substr(split + 4), seconds);
+        if (hasTime)
+            event = record.substr(0, split);
+
+        size_t code = 0;
+        while (code < dictionary.size() && dictionary[code] != event)
+            code++;
+        if (code == dictionary.size())
+            dictionary.push_back(event);
+
+        putVarint(codes, (code << 1) | (hasTime ? 1 : 0));
+        if (hasTime)
+        {
+            putSigned(codes, seconds - previous);
+            previous = seconds;
+        }
+    }
+
+    putVarint(payload, dictionary.size());
+    for (const string &event : dictionary)
+    {
+        putString(payload, event);
+    }
+    payload += codes;
+
+    string block;
+    putU32(block, patientId);
+    putU32(block, records.size());
+    putU32(block, payload.size());
+    block += payload;
+
+    file.seekp(0, ios::end);
+    long long offset = file.tellp();
+    file.write(block.data(), block.size());
+    return file ? offset : -1;
+}
+
+// Reads back the block at the given offset, oldest record first.
+bool readHistoryBlock(int patientId, long long offset, vector<string> &records)
+{
+    ifstream file(historyArchiveFile(patientId), ios::binary);
+    char header[12];
+    if (!file.is_open() || !file.seekg(offset) || !file.read(header, sizeof(header)))
+        return false;
+    if ((int)getU32(header) != patientId)
+        return false;
+
+    unsigned int count = getU32(header + 4);
+    string payload(getU32(header + 8), '\0');
+    if (!file.read(&payload[0], payload.size()))
+        return false;
+
+    size_t pos = 0;
+    unsigned long long dictSize, code;
+    vector<string> dictionary;
+    if (!getVarint(payload, pos, dictSize) || dictSize > payload.size())
+        return false;
+    dictionary.resize(dictSize);
+    for (string &event : dictionary)
+    {
+        if (!getString(payload, pos, event))
+            return false;
+    }
+
+    long long previous = 0, delta;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (!getVarint(payload, pos, code) || (code >> 1) >= dictionary.size())
+            return false;
+
+        string record = dictionary[code >> 1];
+        if (code & 1)
+        {
+            if (!getSigned(payload, pos, delta))
+                return false;
+            previous += delta;
+            record += " on " + formatDateTime(previous);
+        }
+        records.push_back(record);
+    }
+    return true;
+}
+
 // ========== PATIENT CLASS ========== //
 // Stores individual patient details and medical records.
 class Patient
@@ -49,10 +498,13 @@ private:
     string name;
     int age;
     string contact;
-    stack<string> medicalHistory;
-    queue<string> testQueue;
+    deque<string> medicalHistory;   // Recent records, oldest first
+    vector<long long> archivedBlocks; // Archive offsets of older records, oldest first
+    int archivedCount;
     bool isAdmitted;
     RoomType roomType;
+    bool dirty;           // Changed since the last save
+    bool recordsHistory;  // False for replayed states, which track status only
 
 public:
     Patient(int pid, string n, int a, string c)
@@ -63,51 +515,68 @@ public:
         age = a;
         contact = c;
         isAdmitted = false;
+        archivedCount = 0;
+        roomType = GENERAL_WARD;
+        dirty = false;
+        recordsHistory = true;
     }
 
-    void admitPatient(RoomType type)
+    void admitPatient(RoomType type, string when = getCurrentDateTime())
     {
         isAdmitted = true;
         roomType = type;
-        addMedicalRecord("Admitted to " + roomString(type) + " on " + getCurrentDateTime());
+        addMedicalRecord("Admitted to " + roomString(type) + " on " + when);
     }
 
-    void dischargePatient()
+    void dischargePatient(string when = getCurrentDateTime())
     {
         isAdmitted = false;
-        addMedicalRecord("Discharged from hospital on " + getCurrentDateTime());
+        addMedicalRecord("Discharged from hospital on " + when);
     }
 
     void addMedicalRecord(string record)
     {
-        medicalHistory.push(record);
-    }
+        if (!recordsHistory)
+        {
+            return;
+        }
 
-    void requestTest(string testName)
-    {
-        testQueue.push(testName);
-        addMedicalRecord("Requested test: " + testName + " on " + getCurrentDateTime());
+        medicalHistory.push_back(record);
+        if ((int)medicalHistory.size() > HISTORY_HOT_LIMIT)
+        {
+            spillHistory();
+        }
     }
 
-    string performTest()
+    // Moves the oldest in-memory records to the archive as one block.
+    void spillHistory()
     {
-        if (testQueue.empty())
+        vector<string> block(medicalHistory.begin(), medicalHistory.begin() + HISTORY_BLOCK_SIZE);
+        long long offset = appendHistoryBlock(id, block);
+        if (offset < 0)
         {
-            return "No tests are pending";
+            return; // Keep the records in memory if the archive is unavailable
         }
 
-        string testName = testQueue.front();
-        testQueue.pop();
-        addMedicalRecord("Performed test: " + testName + " on " + getCurrentDateTime());
+        archivedBlocks.push_back(offset);
+        archivedCount += HISTORY_BLOCK_SIZE;
+        medicalHistory.erase(medicalHistory.begin(), medicalHistory.begin() + HISTORY_BLOCK_SIZE);
+    }
 
-        return testName;
+    // Tests are queued and performed by the hospital lab pipeline.
+    void requestTest(string testName, string when = getCurrentDateTime())
+    {
+        addMedicalRecord("Requested test: " + testName + " on " + when);
     }
 
-    void displayHistory()
+    void completeTest(string testName, string when = getCurrentDateTime())
     {
-        stack<string> tempHistory = medicalHistory;
+        addMedicalRecord("Performed test: " + testName + " on " + when);
+    }
 
-        if (tempHistory.empty())
+    void displayHistory()
+    {
+        if (medicalHistory.empty() && archivedBlocks.empty())
         {
             cout << "No medical history available." << endl;
             return;
@@ -115,17 +584,70 @@ public:
 
         else
         {
-            // Displaying history in reverse order (LIFO)
+            // Displaying history in reverse order (LIFO), paging in archived blocks after the recent ones
             cout << "\n------- Medical History -------\n";
-            while (!tempHistory.empty())
+            for (auto it = medicalHistory.rbegin(); it != medicalHistory.rend(); ++it)
+            {
+                cout << *it << endl;
+            }
+
+            for (auto block = archivedBlocks.rbegin(); block != archivedBlocks.rend(); ++block)
             {
-                cout << tempHistory.top() << endl;
-                tempHistory.pop();
+                vector<string> records;
+                if (!readHistoryBlock(id, *block, records))
+                {
+                    cerr << "Error: Could not read archived history of patient " << id << ".\n";
+                    break;
+                }
+                for (auto it = records.rbegin(); it != records.rend(); ++it)
+                {
+                    cout << *it << endl;
+                }
             }
             cout << "________________________________________\n\n";
         }
     }
 
+    // Visits every record oldest first, paging archived blocks in one at a time.
+    template <typename F>
+    void forEachRecord(F visit)
+    {
+        for (long long block : archivedBlocks)
+        {
+            vector<string> records;
+            if (!readHistoryBlock(id, block, records))
+            {
+                cerr << "Error: Could not read archived history of patient " << id << ".\n";
+                break;
+            }
+            for (const string &record : records)
+            {
+                visit(record);
+            }
+        }
+
+        for (const string &record : medicalHistory)
+        {
+            visit(record);
+        }
+    }
+
+    int getHistoryLength()
+    {
+        return archivedCount + medicalHistory.size();
+    }
+
+    // Approximate heap bytes held by the in-memory part of the history.
+    size_t getResidentHistoryBytes()
+    {
+        size_t bytes = archivedBlocks.capacity() * sizeof(long long);
+        for (const string &record : medicalHistory)
+        {
+            bytes += sizeof(string) + record.capacity();
+        }
+        return bytes;
+    }
+
     int getId()
     {
         return id;
@@ -153,25 +675,158 @@ public:
 
     string roomString(RoomType type)
     {
-        switch (type)
-        {
-        case GENERAL_WARD:
-            return "General Ward";
-        case ICU:
-            return "ICU";
-        case PRIVATE_ROOM:
-            return "Private Room";
-        case SEMI_PRIVATE:
-            return "Semi-Private Room";
-        default:
-            return "Unknown";
-        }
+        return EnumTable<RoomType>::name(type);
     }
 
     string getRoomTypeAsString()
     {
         return (isAdmitted ? roomString(roomType) : "None");
     }
+
+    RoomType getRoomType()
+    {
+        return roomType;
+    }
+
+    void setHistoryRecording(bool value)
+    {
+        recordsHistory = value;
+    }
+
+    bool isDirty()
+    {
+        return dirty;
+    }
+
+    void setDirty(bool value)
+    {
+        dirty = value;
+    }
+};
+
+// ========== APPOINTMENT QUEUE ========== //
+// Waiting patients of one doctor with their booking times, stored in a ring
+// buffer that doubles when full, so push/pop never shift elements.
+struct Appointment
+{
+    int patientId;
+    long long bookedAt;
+};
+
+class AppointmentQueue
+{
+private:
+    vector<Appointment> slots;
+    size_t head;
+    size_t count;
+
+public:
+    AppointmentQueue()
+    {
+        head = 0;
+        count = 0;
+    }
+
+    void push(Appointment appointment)
+    {
+        if (count == slots.size())
+        {
+            // Unroll into a larger buffer, oldest first
+            vector<Appointment> larger(max<size_t>(4, slots.size() * 2));
+            for (size_t i = 0; i < count; i++)
+                larger[i] = at(i);
+            slots.swap(larger);
+            head = 0;
+        }
+        slots[(head + count) % slots.size()] = appointment;
+        count++;
+    }
+
+    Appointment pop()
+    {
+        Appointment front = slots[head];
+        head = (head + 1) % slots.size();
+        count--;
+        return front;
+    }
+
+    // Drops every appointment of the patient, keeping the others in order; returns how many.
+    size_t removePatient(int patientId)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            Appointment appointment = at(i);
+            if (appointment.patientId != patientId)
+                slots[(head + kept++) % slots.size()] = appointment;
+        }
+        size_t removed = count - kept;
+        count = kept;
+        return removed;
+    }
+
+    // i-th waiting appointment, 0 being the next one.
+    const Appointment &at(size_t i) const
+    {
+        return slots[(head + i) % slots.size()];
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+};
+
+// Histogram with power-of-two buckets, for waiting times (in seconds) and queue
+// lengths: recording is O(1) and a percentile query scans a fixed number of buckets.
+class Histogram
+{
+private:
+    static const int BUCKETS = 40;
+    long long buckets[BUCKETS];
+    long long samples;
+
+public:
+    Histogram()
+    {
+        fill(buckets, buckets + BUCKETS, 0);
+        samples = 0;
+    }
+
+    void record(long long value)
+    {
+        int bucket = 0;
+        while (bucket < BUCKETS - 1 && (1LL << bucket) <= value)
+            bucket++;
+        buckets[bucket]++;
+        samples++;
+    }
+
+    long long getSamples() const
+    {
+        return samples;
+    }
+
+    // Upper bound of the bucket holding the given percentile, -1 without samples.
+    long long percentile(double p) const
+    {
+        if (samples == 0)
+            return -1;
+
+        long long rank = (long long)(p / 100.0 * samples + 0.5), seen = 0;
+        for (int bucket = 0; bucket < BUCKETS; bucket++)
+        {
+            seen += buckets[bucket];
+            if (seen >= max(rank, 1LL))
+                return bucket == 0 ? 0 : (1LL << bucket) - 1;
+        }
+        return (1LL << (BUCKETS - 1)) - 1;
+    }
 };
 
 // ========== DOCTOR CLASS ========== //
@@ -182,8 +837,11 @@ private:
     int id;
     string name;
     Department department;
-    queue<int> appointmentQueue;
-    int appointmentCount;
+    AppointmentQueue appointmentQueue;
+    Histogram waitStats;
+    Histogram queueLengths; // Queue length after each added appointment
+    size_t peakQueueLength;
+    bool dirty; // Changed since the last save
 
 public:
     Doctor(int did, string n, Department d)
@@ -191,35 +849,38 @@ public:
         id = did;
         name = n;
         department = d;
-        appointmentCount = 0;
+        peakQueueLength = 0;
+        dirty = false;
     }
 
-    // New constructor for loading from file
-    Doctor(int did, string n, Department d, int aCount)
+    void addAppointment(int patientId, long long bookedAt = currentTimestamp())
     {
-        id = did;
-        name = n;
-        department = d;
-        appointmentCount = aCount; // to preserve the previous values
+        appointmentQueue.push({patientId, bookedAt});
+        peakQueueLength = max(peakQueueLength, appointmentQueue.size());
+        queueLengths.record(appointmentQueue.size());
     }
 
-    void addAppointment(int patientId)
+    int nextPatient()
     {
-        appointmentQueue.push(patientId);
-        appointmentCount++;
+        return appointmentQueue.empty() ? -1 : appointmentQueue.at(0).patientId;
     }
 
-    int seePatient()
+    // Called when a patient is removed; true if they were waiting.
+    bool cancelAppointments(int patientId)
+    {
+        return appointmentQueue.removePatient(patientId) > 0;
+    }
+
+    int seePatient(long long now = currentTimestamp())
     {
         if (appointmentQueue.empty())
         {
             return -1;
         }
 
-        int nextPatient = appointmentQueue.front();
-        appointmentQueue.pop();
-        appointmentCount--;
-        return nextPatient;
+        Appointment next = appointmentQueue.pop();
+        waitStats.record(max(0LL, now - next.bookedAt));
+        return next.patientId;
     }
 
     int getId()
@@ -234,425 +895,2748 @@ public:
 
     string getDepartment()
     {
-        switch (department)
-        {
-        case CARDIOLOGY:
-            return "Cardiology";
-        case NEUROLOGY:
-            return "Neurology";
-        case ORTHOPEDICS:
-            return "Orthopedics";
-        case PEDIATRICS:
-            return "Pediatrics";
-        case EMERGENCY:
-            return "Emergency";
-        case GENERAL:
-            return "General";
-        default:
-            return "Unknown";
-        }
+        return EnumTable<Department>::name(department);
+    }
+
+    Department getDepartmentType()
+    {
+        return department;
     }
 
+    const AppointmentQueue &getAppointments() const
+    {
+        return appointmentQueue;
+    }
+
+    // Derived from the queue, so it cannot drift from the waiting patients.
     int getAppointmentCount() const
     {
-        return appointmentCount;
+        return appointmentQueue.size();
+    }
+
+    size_t getPeakQueueLength() const
+    {
+        return peakQueueLength;
+    }
+
+    const Histogram &getWaitStats() const
+    {
+        return waitStats;
+    }
+
+    const Histogram &getQueueLengthStats() const
+    {
+        return queueLengths;
+    }
+
+    bool isDirty()
+    {
+        return dirty;
+    }
+
+    void setDirty(bool value)
+    {
+        dirty = value;
     }
 };
 
-// ========== HOSPITAL CLASS ========== //
-// Manages hospital-level operations: patients, doctors, emergencies, data storage.
-class Hospital
+// ========== RECORD FILE ========== //
+// CSV file with fixed-width rows: each row is padded with spaces to the same
+// width, so row i starts at headerSize + i * rowWidth and a changed record can
+// be rewritten in place. Any other layout (or a row that no longer fits) falls
+// back to a full rewrite that picks a new width.
+const int ROW_WIDTH_SLACK = 32;
+
+string trimRight(const string &text)
+{
+    size_t end = text.find_last_not_of(" \r");
+    return end == string::npos ? "" : text.substr(0, end + 1);
+}
+
+// Parses a whole CSV field as a number; false for empty, partial or out-of-range text.
+bool parseLong(const string &text, long long &value)
+{
+    if (text.empty() || isspace((unsigned char)text[0]))
+        return false;
+
+    char *end;
+    errno = 0;
+    value = strtoll(text.c_str(), &end, 10);
+    return errno == 0 && *end == '\0';
+}
+
+bool parseInt(const string &text, int &value)
+{
+    long long wide;
+    if (!parseLong(text, wide) || wide < INT_MIN || wide > INT_MAX)
+        return false;
+    value = (int)wide;
+    return true;
+}
+
+class RecordFile
 {
 private:
-    vector<Patient> patients;
-    vector<Doctor> doctors;
-    queue<int> emergencyQueue;
-    int patientCounter;
-    int doctorCounter;
+    string path;
+    string header;
+    long long rowWidth; // Including the newline, 0 when the layout is unknown
+    long long rowCount; // Rows currently on disk
+
+    long long rowOffset(long long row)
+    {
+        return (long long)header.size() + 1 + row * rowWidth;
+    }
+
+    string padRow(const string &row)
+    {
+        return row + string(rowWidth - row.size() - 1, ' ') + "\n";
+    }
 
 public:
-    Hospital()
+    RecordFile(string p, string h)
     {
-        patientCounter = 0;
-        doctorCounter = 0;
-        loadPatients();
-        loadDoctors();
+        path = p;
+        header = h;
+        rowWidth = 0;
+        rowCount = 0;
     }
 
-    // Save current patient list to CSV file.
-    void savePatients()
+    // Called after loading: keeps the layout only if the header (schema) and
+    // the file size match it exactly.
+    void adoptLayout(long long width, long long rows)
+    {
+        rowWidth = 0;
+        rowCount = 0;
+
+        ifstream file(path, ios::binary);
+        string firstLine;
+        rowCount = rows;
+        if (!file.is_open() || !getline(file, firstLine) || firstLine != header)
+        {
+            return;
+        }
+
+        file.seekg(0, ios::end);
+        if (width > 1 && (long long)file.tellg() == rowOffset(0) + rows * width)
+        {
+            rowWidth = width;
+        }
+    }
+
+    bool hasLayout()
+    {
+        return rowWidth > 0;
+    }
+
+    long long getRowCount()
+    {
+        return rowCount;
+    }
+
+    long long getRowWidth()
+    {
+        return rowWidth;
+    }
+
+    // Byte offset of the first row.
+    long long getDataOffset()
+    {
+        return rowOffset(0);
+    }
+
+    bool fits(const string &row)
+    {
+        return rowWidth > 0 && (long long)row.size() + 1 <= rowWidth;
+    }
+
+    // Rewrites the given rows in place; rows past the end must continue the file in order.
+    bool writeRows(const vector<pair<long long, string>> &rows)
+    {
+        fstream file(path, ios::in | ios::out | ios::binary);
+        if (!file.is_open())
+        {
+            cerr << "Error: Could not open " << path << " for writing.\n";
+            return false;
+        }
+
+        for (auto &row : rows)
+        {
+            string padded = padRow(row.second);
+            file.seekp(rowOffset(row.first));
+            file.write(padded.data(), padded.size());
+            if (row.first >= rowCount)
+                rowCount = row.first + 1;
+        }
+        return (bool)file;
+    }
+
+    // Drops the rows past the given count (after records were removed).
+    bool truncateRows(long long rows)
+    {
+        if (rowWidth == 0 || rows >= rowCount)
+        {
+            return true;
+        }
+
+        error_code error;
+        filesystem::resize_file(path, rowOffset(rows), error);
+        if (error)
+        {
+            cerr << "Error: Could not resize " << path << ".\n";
+            return false;
+        }
+        rowCount = rows;
+        return true;
+    }
+
+    bool rewrite(const vector<string> &rows)
+    {
+        ofstream file(path, ios::binary | ios::trunc);
+        if (!file.is_open())
+        {
+            cerr << "Error: Could not open " << path << " for writing.\n";
+            return false;
+        }
+
+        size_t widest = 0;
+        for (const string &row : rows)
+            widest = max(widest, row.size());
+        rowWidth = widest + 1 + ROW_WIDTH_SLACK;
+        rowCount = rows.size();
+
+        string buffer = header + "\n";
+        for (const string &row : rows)
+            buffer += padRow(row);
+        file.write(buffer.data(), buffer.size());
+        return (bool)file;
+    }
+};
+
+// ========== OBJECT POOL ========== //
+// Slab allocator for patients and doctors. Objects live in fixed-size slabs
+// that never move, so pointers stay valid while the pool grows. Freed slots
+// are reused in O(1) through a free list; handles carry the slot generation
+// and stop resolving once their object is freed.
+struct Handle
+{
+    unsigned int index;
+    unsigned int generation;
+};
+
+template <typename T>
+class SlabPool
+{
+private:
+    static const unsigned int SLAB_SIZE = 4096;
+    static const unsigned int NO_SLOT = 0xFFFFFFFFu;
+
+    struct Slot
+    {
+        alignas(T) unsigned char storage[sizeof(T)];
+        unsigned int generation;
+        unsigned int nextFree;
+        bool live;
+    };
+
+    vector<unique_ptr<Slot[]>> slabs;
+    unsigned int slotCount;
+    unsigned int freeHead;
+    size_t liveCount;
+
+    Slot &slot(unsigned int index)
+    {
+        return slabs[index / SLAB_SIZE][index % SLAB_SIZE];
+    }
+
+    T *object(Slot &s)
+    {
+        return reinterpret_cast<T *>(s.storage);
+    }
+
+public:
+    SlabPool()
+    {
+        slotCount = 0;
+        freeHead = NO_SLOT;
+        liveCount = 0;
+    }
+
+    SlabPool(const SlabPool &) = delete;
+    SlabPool &operator=(const SlabPool &) = delete;
+
+    ~SlabPool()
+    {
+        forEach([](T &value)
+                { value.~T(); });
+    }
+
+    template <typename... Args>
+    Handle allocate(Args &&...args)
+    {
+        unsigned int index;
+        if (freeHead != NO_SLOT)
+        {
+            index = freeHead;
+            freeHead = slot(index).nextFree;
+        }
+        else
+        {
+            if (slotCount % SLAB_SIZE == 0)
+                slabs.push_back(unique_ptr<Slot[]>(new Slot[SLAB_SIZE]()));
+            index = slotCount++;
+        }
+
+        Slot &s = slot(index);
+        new (s.storage) T(forward<Args>(args)...);
+        s.live = true;
+        liveCount++;
+        return {index, s.generation};
+    }
+
+    bool release(Handle handle)
+    {
+        T *value = get(handle);
+        if (value == nullptr)
+            return false;
+
+        Slot &s = slot(handle.index);
+        value->~T();
+        s.live = false;
+        s.generation++; // Invalidates every outstanding handle to this slot
+        s.nextFree = freeHead;
+        freeHead = handle.index;
+        liveCount--;
+        return true;
+    }
+
+    T *get(Handle handle)
+    {
+        if (handle.index >= slotCount)
+            return nullptr;
+
+        Slot &s = slot(handle.index);
+        return (s.live && s.generation == handle.generation) ? object(s) : nullptr;
+    }
+
+    // Visits live objects in memory order.
+    template <typename F>
+    void forEach(F visit)
+    {
+        for (unsigned int i = 0; i < slotCount; i++)
+        {
+            Slot &s = slot(i);
+            if (s.live)
+                visit(*object(s));
+        }
+    }
+
+    size_t size() const
+    {
+        return liveCount;
+    }
+
+    // Bytes reserved by the slabs (excluding heap memory owned by the objects).
+    size_t memoryBytes() const
+    {
+        return slabs.size() * SLAB_SIZE * sizeof(Slot) + slabs.capacity() * sizeof(unique_ptr<Slot[]>);
+    }
+};
+
+// ========== ENTITY REGISTRY ========== //
+// Pool-backed patients or doctors with O(1) lookup by ID, plus the file row
+// of each entity and the rows changed since the last save.
+// Entities can also be registered lazily with just their file offset: they
+// are read through loadEntity and kept on first lookup, while iterations and
+// full rewrites read them only for the visit, so memory stays proportional to
+// the entities actually used. A lazy entity that cannot be read is kept as it
+// is: only a logged removal may drop it from the file.
+template <typename T>
+class Registry
+{
+private:
+    struct Entry
+    {
+        Handle handle; // Valid once loaded
+        long long row;
+        long long offset; // File offset while not loaded
+        bool loaded;
+    };
+
+    SlabPool<T> pool;
+    unordered_map<int, Entry> byId;
+    vector<int> rowIds; // ID stored at each file row
+    vector<long long> dirtyRows;
+    size_t notLoaded;
+
+    // Reads a lazy entity; nothing if its row is unreadable or holds another ID.
+    // Another ID means the offsets are out of date: they are rescanned once.
+    optional<T> read(int id, const Entry &entry)
+    {
+        optional<T> entity = loadEntity(entry.offset);
+        if (entity && entity->getId() != id && rescanOffsets)
+        {
+            for (auto &found : rescanOffsets())
+            {
+                auto it = byId.find(found.first);
+                if (it != byId.end() && !it->second.loaded)
+                    it->second.offset = found.second;
+            }
+            entity = loadEntity(entry.offset);
+        }
+        if (entity && entity->getId() != id)
+            entity.reset();
+        if (entity)
+            entity->setDirty(false);
+        return entity;
+    }
+
+public:
+    function<optional<T>(long long offset)> loadEntity;
+    function<unordered_map<int, long long>()> rescanOffsets; // ID -> offset of every row in the file
+
+    Registry()
+    {
+        notLoaded = 0;
+    }
+
+    T *find(int id)
+    {
+        auto it = byId.find(id);
+        if (it == byId.end())
+            return nullptr;
+        if (it->second.loaded)
+            return pool.get(it->second.handle);
+
+        optional<T> entity = read(id, it->second);
+        if (!entity)
+        {
+            return nullptr; // Kept lazy: a later lookup may still read it
+        }
+
+        it->second.handle = pool.allocate(move(*entity));
+        it->second.loaded = true;
+        notLoaded--;
+        return pool.get(it->second.handle);
+    }
+
+    // Registers an entity that is only read on first access; false if the ID is taken.
+    bool addLazy(int id, long long offset)
+    {
+        if (byId.count(id))
+            return false;
+
+        byId[id] = {{0, 0}, (long long)rowIds.size(), offset, false};
+        rowIds.push_back(id);
+        notLoaded++;
+        return true;
+    }
+
+    size_t getNotLoadedCount() const
+    {
+        return notLoaded;
+    }
+
+    const vector<int> &getRowIds() const
+    {
+        return rowIds;
+    }
+
+    // Adds the entity in the next file row; nullptr if the ID is taken.
+    T *add(T entity, bool dirty)
+    {
+        int id = entity.getId();
+        if (byId.count(id))
+            return nullptr;
+
+        Handle handle = pool.allocate(move(entity));
+        byId[id] = {handle, (long long)rowIds.size(), 0, true};
+        rowIds.push_back(id);
+
+        T *added = pool.get(handle);
+        added->setDirty(false);
+        if (dirty)
+            markDirty(*added);
+        return added;
+    }
+
+    // Whether remove(id) can move the last file row into its place: the entity
+    // there must be read while its own row is still on disk.
+    bool canRemove(int id)
+    {
+        return byId.count(id) && (rowIds.back() == id || find(rowIds.back()) != nullptr);
+    }
+
+    // Frees the entity; the last file row moves into its place.
+    bool remove(int id)
+    {
+        if (!canRemove(id))
+            return false;
+
+        auto it = byId.find(id);
+        long long row = it->second.row;
+        if (it->second.loaded)
+            pool.release(it->second.handle);
+        else
+            notLoaded--;
+        byId.erase(it);
+
+        int lastId = rowIds.back();
+        rowIds.pop_back();
+        if (row < (long long)rowIds.size())
+        {
+            rowIds[row] = lastId;
+            byId[lastId].row = row;
+            dirtyRows.push_back(row);
+            find(lastId)->setDirty(true);
+        }
+        return true;
+    }
+
+    bool hasUnsavedRows() const
+    {
+        return !dirtyRows.empty();
+    }
+
+    void markDirty(T &entity)
+    {
+        if (!entity.isDirty())
+        {
+            entity.setDirty(true);
+            dirtyRows.push_back(byId[entity.getId()].row);
+        }
+    }
+
+    // Rows changed since the last save, in file order; clears the dirty flags.
+    vector<pair<long long, T *>> takeDirtyRows()
+    {
+        sort(dirtyRows.begin(), dirtyRows.end());
+        dirtyRows.erase(unique(dirtyRows.begin(), dirtyRows.end()), dirtyRows.end());
+
+        vector<pair<long long, T *>> changed;
+        for (long long row : dirtyRows)
+        {
+            if (row < (long long)rowIds.size())
+            {
+                T *entity = find(rowIds[row]);
+                entity->setDirty(false);
+                changed.push_back({row, entity});
+            }
+        }
+        dirtyRows.clear();
+        return changed;
+    }
+
+    // Visits every entity in row order for a full rewrite and clears the dirty
+    // rows; false, with nothing cleared, as soon as a lazy row cannot be read.
+    template <typename F>
+    bool takeAllRows(F visit)
+    {
+        for (int id : rowIds)
+        {
+            Entry &entry = byId[id];
+            if (entry.loaded)
+            {
+                visit(*pool.get(entry.handle));
+                continue;
+            }
+
+            optional<T> entity = read(id, entry);
+            if (!entity)
+                return false;
+            visit(*entity);
+        }
+
+        pool.forEach([](T &entity)
+                     { entity.setDirty(false); });
+        dirtyRows.clear();
+        return true;
+    }
+
+    // Points lazy entities at their rows after the file was rewritten.
+    void relocateLazy(long long firstRowOffset, long long rowWidth)
+    {
+        if (notLoaded == 0)
+            return;
+
+        for (auto &entry : byId)
+        {
+            if (!entry.second.loaded)
+                entry.second.offset = firstRowOffset + entry.second.row * rowWidth;
+        }
+    }
+
+    // Lazy entities are read for the visit only: changes made to them are not kept.
+    template <typename F>
+    void forEach(F visit)
+    {
+        pool.forEach(visit);
+        if (notLoaded == 0)
+            return;
+
+        for (int id : rowIds)
+        {
+            const Entry &entry = byId[id];
+            if (entry.loaded)
+                continue;
+
+            optional<T> entity = read(id, entry);
+            if (entity)
+                visit(*entity);
+        }
+    }
+
+    long long rowCount() const
+    {
+        return rowIds.size();
+    }
+
+    size_t size() const
+    {
+        return byId.size();
+    }
+
+    size_t memoryBytes() const
+    {
+        return pool.memoryBytes() + byId.size() * (sizeof(int) + sizeof(Entry) + 2 * sizeof(void *)) +
+               rowIds.capacity() * sizeof(int);
+    }
+};
+
+// ========== EVENT LOG ========== //
+// Append-only binary stream of typed Hospital events. Each event is encoded as
+// its type, the timestamp delta to the previous event (zigzag varint) and its
+// fields. Every session starts with SESSION_STARTED, whose delta is taken from
+// 0, so appending never needs to read the existing log.
+enum EventType
+{
+    SESSION_STARTED,
+    PATIENT_REGISTERED,
+    DOCTOR_ADDED,
+    PATIENT_ADMITTED,
+    PATIENT_DISCHARGED,
+    PATIENT_REMOVED,
+    TEST_REQUESTED,
+    TEST_PERFORMED,
+    APPOINTMENT_BOOKED,
+    PATIENT_SEEN,
+    EMERGENCY_ADDED,
+    EMERGENCY_HANDLED,
+    EVENT_TYPE_COUNT
+};
+
+struct HospitalEvent
+{
+    EventType type;
+    long long timestamp; // Seconds, as parsed from getCurrentDateTime()
+    int id;              // Patient ID, or doctor ID for doctor events
+    int otherId;         // Patient ID of an appointment
+    int number;          // Age, room type or department
+    string text;         // Name or test name
+    string contact;
+};
+
+HospitalEvent makeEvent(EventType type, int id = 0, int otherId = 0, int number = 0, string text = "", string contact = "")
+{
+    return {type, currentTimestamp(), id, otherId, number, text, contact};
+}
+
+void encodeEvent(string &out, const HospitalEvent &event, long long &previous)
+{
+    if (event.type == SESSION_STARTED)
+        previous = 0;
+
+    out.push_back((char)event.type);
+    putSigned(out, event.timestamp - previous);
+    putSigned(out, event.id);
+    putSigned(out, event.otherId);
+    putSigned(out, event.number);
+    putString(out, event.text);
+    putString(out, event.contact);
+    previous = event.timestamp;
+}
+
+// Returns false (leaving pos unchanged) when the buffer ends mid-event or the data is invalid.
+bool decodeEvent(const string &in, size_t &pos, HospitalEvent &event, long long &previous)
+{
+    size_t start = pos;
+    long long delta, id, otherId, number;
+    if (pos >= in.size() || (unsigned char)in[pos] >= EVENT_TYPE_COUNT)
+        return false;
+
+    event.type = (EventType)in[pos++];
+    if (!getSigned(in, pos, delta) || !getSigned(in, pos, id) || !getSigned(in, pos, otherId) ||
+        !getSigned(in, pos, number) || !getString(in, pos, event.text) || !getString(in, pos, event.contact))
+    {
+        pos = start;
+        return false;
+    }
+
+    previous = (event.type == SESSION_STARTED ? 0 : previous) + delta;
+    event.timestamp = previous;
+    event.id = id;
+    event.otherId = otherId;
+    event.number = number;
+    return true;
+}
+
+class EventLog
+{
+private:
+    string path;
+    ofstream file;
+    long long previous;
+    string buffer;
+
+public:
+    EventLog(string p)
+    {
+        path = p;
+        previous = 0;
+    }
+
+    // Opens the log for appending; returns true when it held no events before.
+    bool open()
+    {
+        file.open(path, ios::binary | ios::app);
+        if (!file.is_open())
+        {
+            cerr << "Error: Could not open " << path << " for writing.\n";
+            return false;
+        }
+
+        file.seekp(0, ios::end);
+        bool fresh = file.tellp() == 0;
+        append(makeEvent(SESSION_STARTED));
+        file.flush(); // Replays during this session must see that it started
+        return fresh;
+    }
+
+    void append(const HospitalEvent &event)
+    {
+        if (!file.is_open())
+            return;
+
+        buffer.clear();
+        encodeEvent(buffer, event, previous);
+        file.write(buffer.data(), buffer.size());
+    }
+
+    void flush()
+    {
+        file.flush();
+    }
+};
+
+// Sequential reader over the event log, refilling its buffer in chunks.
+class EventReader
+{
+private:
+    ifstream file;
+    string buffer;
+    size_t pos;
+    long long bufferOffset; // File offset of buffer[0]
+    long long previous;
+
+public:
+    EventReader(string path, long long offset, long long previousTimestamp) : file(path, ios::binary)
+    {
+        file.seekg(offset);
+        pos = 0;
+        bufferOffset = offset;
+        previous = previousTimestamp;
+    }
+
+    bool next(HospitalEvent &event)
+    {
+        while (!decodeEvent(buffer, pos, event, previous))
+        {
+            // Keep the partial event and read the next chunk after it
+            bufferOffset += pos;
+            buffer.erase(0, pos);
+            pos = 0;
+
+            size_t kept = buffer.size();
+            buffer.resize(kept + (1 << 20));
+            file.read(&buffer[kept], 1 << 20);
+            buffer.resize(kept + file.gcount());
+            if (file.gcount() == 0)
+                return false;
+        }
+        return true;
+    }
+
+    // Offset of the next event, and the timestamp it is delta-encoded against.
+    long long offset()
+    {
+        return bufferOffset + pos;
+    }
+
+    long long previousTimestamp()
+    {
+        return previous;
+    }
+};
+
+// ========== LAB PIPELINE ========== //
+// Hospital-wide test orders, partitioned into lanes by test type.
+// Each worker serves its own lane first and steals from the others when idle.
+struct TestOrder
+{
+    int patientId;
+    string testName;
+    chrono::steady_clock::time_point requestedAt;
+};
+
+class LabPipeline
+{
+private:
+    struct Lane
+    {
+        mutex laneMutex;
+        deque<TestOrder> orders;
+    };
+
+    vector<Lane> lanes;
+    vector<thread> workers;
+    function<void(const TestOrder &)> onComplete;
+
+    mutex waitMutex;
+    condition_variable workAvailable;
+    atomic<int> pending;
+    bool stopping;
+
+    mutex statsMutex;
+    condition_variable idle; // Signalled when every queued test is completed
+    long long queuedCount;
+    long long completedCount;
+    double totalLatencyMs;
+    double maxLatencyMs;
+    chrono::steady_clock::time_point firstOrderAt;
+    chrono::steady_clock::time_point lastCompletedAt;
+
+    size_t laneFor(const string &testName)
+    {
+        return hash<string>()(testName) % lanes.size();
+    }
+
+    bool takeOrder(size_t homeLane, TestOrder &order)
+    {
+        for (size_t i = 0; i < lanes.size(); i++)
+        {
+            Lane &lane = lanes[(homeLane + i) % lanes.size()];
+            lock_guard<mutex> lock(lane.laneMutex);
+            if (!lane.orders.empty())
+            {
+                // Own lane from the front, stolen work from the back
+                if (i == 0)
+                {
+                    order = lane.orders.front();
+                    lane.orders.pop_front();
+                }
+                else
+                {
+                    order = lane.orders.back();
+                    lane.orders.pop_back();
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(size_t homeLane)
+    {
+        while (true)
+        {
+            TestOrder order;
+            if (takeOrder(homeLane, order))
+            {
+                pending--;
+                onComplete(order);
+                recordCompletion(order);
+                continue;
+            }
+
+            unique_lock<mutex> lock(waitMutex);
+            if (stopping && pending == 0)
+            {
+                return;
+            }
+            workAvailable.wait(lock, [this]
+                               { return stopping || pending > 0; });
+        }
+    }
+
+    void recordCompletion(const TestOrder &order)
+    {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        double latencyMs = chrono::duration<double, milli>(now - order.requestedAt).count();
+        lock_guard<mutex> lock(statsMutex);
+        completedCount++;
+        lastCompletedAt = max(lastCompletedAt, now);
+        totalLatencyMs += latencyMs;
+        if (latencyMs > maxLatencyMs)
+            maxLatencyMs = latencyMs;
+        if (completedCount == queuedCount)
+            idle.notify_all();
+    }
+
+public:
+    LabPipeline(int workerCount, function<void(const TestOrder &)> callback)
+        : lanes(workerCount), onComplete(callback), pending(0)
+    {
+        stopping = false;
+        queuedCount = 0;
+        completedCount = 0;
+        totalLatencyMs = 0;
+        maxLatencyMs = 0;
+
+        for (int i = 0; i < workerCount; i++)
+        {
+            workers.push_back(thread(&LabPipeline::workerLoop, this, i));
+        }
+    }
+
+    // Performs every queued test before the workers exit.
+    ~LabPipeline()
+    {
+        {
+            lock_guard<mutex> lock(waitMutex);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for (thread &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    void submit(int patientId, string testName)
+    {
+        TestOrder order = {patientId, testName, chrono::steady_clock::now()};
+        if (lanes.empty())
+        {
+            // No workers: perform the test right away
+            {
+                lock_guard<mutex> lock(statsMutex);
+                if (queuedCount++ == 0)
+                    firstOrderAt = order.requestedAt;
+            }
+            onComplete(order);
+            recordCompletion(order);
+            return;
+        }
+
+        {
+            lock_guard<mutex> lock(statsMutex);
+            if (queuedCount == 0)
+                firstOrderAt = order.requestedAt;
+            queuedCount++;
+        }
+        {
+            // Counted before it is published, so a worker taking it at once never drives pending below 0
+            lock_guard<mutex> lock(waitMutex);
+            pending++;
+        }
+        {
+            Lane &lane = lanes[laneFor(testName)];
+            lock_guard<mutex> lock(lane.laneMutex);
+            lane.orders.push_back(order);
+        }
+        workAvailable.notify_one();
+    }
+
+    int getPendingCount() const
+    {
+        return pending;
+    }
+
+    long long getCompletedCount()
+    {
+        lock_guard<mutex> lock(statsMutex);
+        return completedCount;
+    }
+
+    // Blocks until every test submitted so far has been performed.
+    void waitUntilIdle()
+    {
+        unique_lock<mutex> lock(statsMutex);
+        idle.wait(lock, [this]
+                  { return completedCount == queuedCount; });
+    }
+
+    void displayStats()
+    {
+        lock_guard<mutex> lock(statsMutex);
+        // Up to the last completion, so idle time does not lower the throughput
+        double elapsed = completedCount ? chrono::duration<double>(lastCompletedAt - firstOrderAt).count() : 0;
+
+        cout << "\n========= Lab Pipeline =========\n";
+        cout << "Workers : " << workers.size() << endl;
+        cout << "Tests Queued : " << queuedCount << endl;
+        cout << "Tests Pending : " << pending << endl;
+        cout << "Tests Completed : " << completedCount << endl;
+        cout << "Throughput : " << (elapsed > 0 ? completedCount / elapsed : 0) << " tests/s" << endl;
+        cout << "Average Latency : " << (completedCount ? totalLatencyMs / completedCount : 0) << " ms" << endl;
+        cout << "Max Latency : " << maxLatencyMs << " ms" << endl
+             << endl;
+    }
+};
+
+// ========== HOSPITAL CLASS ========== //
+// Manages hospital-level operations: patients, doctors, emergencies, data storage.
+class Hospital
+{
+private:
+    friend class EventReplay;
+
+    Registry<Patient> patients;
+    Registry<Doctor> doctors;
+    queue<int> emergencyQueue;
+    int patientCounter;
+    int savedPatientCounter; // Highest issued ID stored in patients.idx
+    int doctorCounter;
+    bool replica; // State rebuilt by EventReplay: no files, no history, no lab workers
+    bool appointmentsChanged; // Queues changed since appointments.csv was written
+    RecordFile patientFile;
+    RecordFile doctorFile;
+    EventLog eventLog;
+    recursive_mutex patientsMutex; // Lab workers update patient histories concurrently
+    ifstream patientReader;        // Reads lazily loaded patient rows
+    LabPipeline lab;               // Declared last so pending tests finish before patients go away
+
+    Hospital(bool replicaState) : replica(replicaState),
+                                  patientFile(PATIENT_FILE, "ID,Name,Age,Contact,Admission Status,Room Type"),
+                                  doctorFile(DOCTOR_FILE, "ID,Name,Department,Appointment"),
+                                  eventLog(EVENT_FILE),
+                                  lab(replicaState ? 0 : LAB_WORKERS, [this](const TestOrder &order)
+                                      { completeTest(order); })
+    {
+        patientCounter = 0;
+        savedPatientCounter = 0;
+        appointmentsChanged = false;
+        doctorCounter = 0;
+        if (replica)
+        {
+            return;
+        }
+
+        loadPatients();
+        loadDoctors();
+        if (eventLog.open())
+        {
+            logInitialState();
+        }
+    }
+
+    // Completion callback of the lab pipeline (runs on a worker thread).
+    void completeTest(const TestOrder &order)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        if (patients.find(order.patientId) != nullptr)
+        {
+            record(makeEvent(TEST_PERFORMED, order.patientId, 0, 0, order.testName));
+        }
+    }
+
+    // Appends the event to the log and applies it to the in-memory state.
+    void record(const HospitalEvent &event)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        eventLog.append(event);
+        eventLog.flush();
+        apply(event);
+    }
+
+    // The only place where operations change hospital state, so live
+    // operations and replays rebuild exactly the same state.
+    void apply(const HospitalEvent &event)
+    {
+        string when = formatDateTime(event.timestamp);
+        Patient *p = nullptr;
+        Doctor *d = nullptr;
+        if (event.type == APPOINTMENT_BOOKED || event.type == PATIENT_SEEN || event.type == DOCTOR_ADDED)
+            d = doctors.find(event.id);
+        else
+            p = patients.find(event.id);
+
+        switch (event.type)
+        {
+        case SESSION_STARTED:
+            // The emergency queue is not persisted, so a restart starts it empty
+            emergencyQueue = queue<int>();
+            break;
+        case PATIENT_REGISTERED:
+        {
+            Patient patient(event.id, event.text, event.number, event.contact);
+            patient.setHistoryRecording(!replica);
+            patients.add(patient, true);
+            patientCounter = max(patientCounter, event.id);
+            break;
+        }
+        case DOCTOR_ADDED:
+            doctors.add(Doctor(event.id, event.text, static_cast<Department>(event.number)), true);
+            doctorCounter = max(doctorCounter, event.id);
+            break;
+        case PATIENT_ADMITTED:
+            if (p != nullptr)
+            {
+                p->admitPatient(static_cast<RoomType>(event.number), when);
+                patients.markDirty(*p);
+            }
+            break;
+        case PATIENT_DISCHARGED:
+            if (p != nullptr)
+            {
+                p->dischargePatient(when);
+                patients.markDirty(*p);
+            }
+            break;
+        case PATIENT_REMOVED:
+        {
+            patients.remove(event.id);
+            // A removed ID must not stay queued anywhere
+            doctors.forEach([this, &event](Doctor &doctor)
+                            {
+                                if (doctor.cancelAppointments(event.id))
+                                {
+                                    doctors.markDirty(doctor);
+                                    appointmentsChanged = true;
+                                } });
+            queue<int> emergencies;
+            for (; !emergencyQueue.empty(); emergencyQueue.pop())
+            {
+                if (emergencyQueue.front() != event.id)
+                    emergencies.push(emergencyQueue.front());
+            }
+            emergencyQueue.swap(emergencies);
+            break;
+        }
+        case TEST_REQUESTED:
+            if (p != nullptr)
+                p->requestTest(event.text, when);
+            break;
+        case TEST_PERFORMED:
+            if (p != nullptr)
+                p->completeTest(event.text, when);
+            break;
+        case APPOINTMENT_BOOKED:
+            p = patients.find(event.otherId);
+            if (d != nullptr)
+            {
+                d->addAppointment(event.otherId, event.timestamp);
+                doctors.markDirty(*d);
+                appointmentsChanged = true;
+            }
+            if (p != nullptr)
+                p->addMedicalRecord("Appointment booked with Doctor ID " + to_string(event.id) + " on " + when);
+            break;
+        case PATIENT_SEEN:
+            if (d != nullptr && d->seePatient(event.timestamp) != -1)
+            {
+                doctors.markDirty(*d);
+                appointmentsChanged = true;
+            }
+            break;
+        case EMERGENCY_ADDED:
+            emergencyQueue.push(event.id);
+            if (p != nullptr)
+                p->addMedicalRecord("Marked as Emergency Case on " + when);
+            break;
+        case EMERGENCY_HANDLED:
+            if (!emergencyQueue.empty())
+            {
+                p = patients.find(emergencyQueue.front());
+                emergencyQueue.pop();
+                if (p != nullptr)
+                    p->addMedicalRecord("Emergency Case Handled on " + when);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    // A new event log starts with the state loaded from the CSV files.
+    void logInitialState()
+    {
+        patients.forEach([this](Patient &p)
+                         {
+                             eventLog.append(makeEvent(PATIENT_REGISTERED, p.getId(), 0, p.getAge(), p.getName(), p.getContact()));
+                             if (p.getAdmissionStatus())
+                                 eventLog.append(makeEvent(PATIENT_ADMITTED, p.getId(), 0, p.getRoomType())); });
+        doctors.forEach([this](Doctor &d)
+                        {
+                            eventLog.append(makeEvent(DOCTOR_ADDED, d.getId(), 0, d.getDepartmentType(), d.getName()));
+                            const AppointmentQueue &queued = d.getAppointments();
+                            for (size_t i = 0; i < queued.size(); i++)
+                            {
+                                HospitalEvent booked = makeEvent(APPOINTMENT_BOOKED, d.getId(), queued.at(i).patientId);
+                                booked.timestamp = queued.at(i).bookedAt;
+                                eventLog.append(booked);
+                            } });
+        eventLog.flush();
+    }
+
+    // Compact encoding of the replayed state, used for checkpoints.
+    string serializeState()
+    {
+        string out;
+        putSigned(out, patientCounter);
+        putSigned(out, doctorCounter);
+
+        putVarint(out, patients.size());
+        patients.forEach([&out](Patient &p)
+                         {
+                             putSigned(out, p.getId());
+                             putString(out, p.getName());
+                             putSigned(out, p.getAge());
+                             putString(out, p.getContact());
+                             putVarint(out, p.getAdmissionStatus() ? p.getRoomType() + 1 : 0); });
+
+        putVarint(out, doctors.size());
+        doctors.forEach([&out](Doctor &d)
+                        {
+                            const AppointmentQueue &queued = d.getAppointments();
+                            putSigned(out, d.getId());
+                            putString(out, d.getName());
+                            putVarint(out, d.getDepartmentType());
+                            putVarint(out, queued.size());
+                            for (size_t i = 0; i < queued.size(); i++)
+                            {
+                                putSigned(out, queued.at(i).patientId);
+                                putSigned(out, queued.at(i).bookedAt);
+                            } });
+
+        queue<int> emergencies = emergencyQueue;
+        putVarint(out, emergencies.size());
+        for (; !emergencies.empty(); emergencies.pop())
+            putSigned(out, emergencies.front());
+        return out;
+    }
+
+    bool restoreState(const string &in)
+    {
+        size_t pos = 0;
+        long long pc, dc, id, age, patientId, bookedAt;
+        unsigned long long patientTotal, doctorTotal, room, dept, queued, emergencies;
+        string name, contact;
+
+        if (!getSigned(in, pos, pc) || !getSigned(in, pos, dc) || !getVarint(in, pos, patientTotal))
+            return false;
+        patientCounter = pc;
+        doctorCounter = dc;
+
+        for (unsigned long long i = 0; i < patientTotal; i++)
+        {
+            if (!getSigned(in, pos, id) || !getString(in, pos, name) || !getSigned(in, pos, age) ||
+                !getString(in, pos, contact) || !getVarint(in, pos, room))
+                return false;
+
+            Patient patient(id, name, age, contact);
+            patient.setHistoryRecording(false);
+            if (room > 0)
+                patient.admitPatient(static_cast<RoomType>(room - 1));
+            patients.add(patient, false);
+        }
+
+        if (!getVarint(in, pos, doctorTotal))
+            return false;
+        for (unsigned long long i = 0; i < doctorTotal; i++)
+        {
+            if (!getSigned(in, pos, id) || !getString(in, pos, name) || !getVarint(in, pos, dept) ||
+                !getVarint(in, pos, queued))
+                return false;
+
+            Doctor doctor(id, name, static_cast<Department>(dept));
+            for (unsigned long long j = 0; j < queued; j++)
+            {
+                if (!getSigned(in, pos, patientId) || !getSigned(in, pos, bookedAt))
+                    return false;
+                doctor.addAppointment(patientId, bookedAt);
+            }
+            doctors.add(doctor, false);
+        }
+
+        if (!getVarint(in, pos, emergencies))
+            return false;
+        for (unsigned long long i = 0; i < emergencies; i++)
+        {
+            if (!getSigned(in, pos, patientId))
+                return false;
+            emergencyQueue.push(patientId);
+        }
+        return true;
+    }
+
+    string patientRow(Patient &p)
+    {
+        return to_string(p.getId()) + "," + p.getName() + "," + to_string(p.getAge()) + "," + p.getContact() + "," +
+               (p.getAdmissionStatus() ? "Admitted" : "Not Admitted") + "," + p.getRoomTypeAsString();
+    }
+
+    string doctorRow(Doctor &d)
+    {
+        return to_string(d.getId()) + "," + d.getName() + "," + d.getDepartment() + "," + to_string(d.getAppointmentCount());
+    }
+
+    // Writes the changed rows of a registry in place, or the whole file when
+    // its layout is unknown or a row outgrew the row width.
+    template <typename T>
+    void saveChanges(Registry<T> &registry, RecordFile &file, string (Hospital::*formatRow)(T &))
+    {
+        if (replica)
+        {
+            return;
+        }
+
+        vector<pair<long long, T *>> changed = registry.takeDirtyRows();
+        bool shrunk = registry.rowCount() < file.getRowCount();
+        if (changed.empty() && !shrunk)
+        {
+            return;
+        }
+
+        vector<pair<long long, string>> rows;
+        bool fullRewrite = !file.hasLayout();
+        for (auto &entry : changed)
+        {
+            rows.push_back({entry.first, (this->*formatRow)(*entry.second)});
+            fullRewrite = fullRewrite || !file.fits(rows.back().second);
+        }
+
+        if (fullRewrite)
+        {
+            vector<string> all;
+            if (!registry.takeAllRows([&](T &entity)
+                                      { all.push_back((this->*formatRow)(entity)); }))
+            {
+                // Writing the file without the unreadable rows would lose them
+                cerr << "Error: Some records could not be read, the file was not saved.\n";
+                for (auto &entry : changed)
+                {
+                    registry.markDirty(*entry.second);
+                }
+                return;
+            }
+            file.rewrite(all);
+            registry.relocateLazy(file.getDataOffset(), file.getRowWidth());
+        }
+        else
+        {
+            file.writeRows(rows);
+            file.truncateRows(registry.rowCount());
+        }
+    }
+
+public:
+    Hospital() : Hospital(false)
+    {
+    }
+
+    ~Hospital()
+    {
+        if (!replica && LAZY_PATIENT_LOADING)
+        {
+            savePatientIndex();
+        }
+    }
+
+    // Hospital that never touches files or starts lab workers (tests are
+    // performed immediately) and keeps no history text; for tests and fuzzing.
+    static unique_ptr<Hospital> createInMemory()
+    {
+        return unique_ptr<Hospital>(new Hospital(true));
+    }
+
+    Patient *findPatient(int patientId)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        return patients.find(patientId);
+    }
+
+    Doctor *findDoctor(int doctorId)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        return doctors.find(doctorId);
+    }
+
+    size_t getPatientCount()
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        return patients.size();
+    }
+
+    size_t getLoadedPatientCount()
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        return patients.size() - patients.getNotLoadedCount();
+    }
+
+    size_t getDoctorCount()
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        return doctors.size();
+    }
+
+    size_t getEmergencyCount()
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        return emergencyQueue.size();
+    }
+
+    int getPendingTestCount()
+    {
+        return lab.getPendingCount();
+    }
+
+    // Waits for the lab workers, so patient histories are no longer changing.
+    void waitForTests()
+    {
+        lab.waitUntilIdle();
+    }
+
+    template <typename F>
+    void forEachPatient(F visit)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        patients.forEach(visit);
+    }
+
+    template <typename F>
+    void forEachDoctor(F visit)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        doctors.forEach(visit);
+    }
+
+    // Visits the emergency queue in order as (position, patientId).
+    template <typename F>
+    void forEachEmergency(F visit)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        queue<int> pending = emergencyQueue;
+        for (int position = 0; !pending.empty(); position++, pending.pop())
+        {
+            visit(position, pending.front());
+        }
+    }
+
+    // Save changed patients to the CSV file: changed rows are rewritten in place,
+    // the whole file only when its layout is unknown or a row outgrew its width.
+    void savePatients()
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        saveChanges(patients, patientFile, &Hospital::patientRow);
+        if (!replica && patientCounter > savedPatientCounter)
+        {
+            savePatientCounter();
+        }
+    }
+
+    void saveDoctors()
+    {
+        saveChanges(doctors, doctorFile, &Hospital::doctorRow);
+        saveAppointments();
+    }
+
+    // Waiting appointments, one row each in queue order: Doctor ID,Patient ID,Booked At.
+    // Kept out of doctors.csv so doctor rows stay fixed-width however long queues get;
+    // the file only holds pending appointments and is rewritten when a queue changes.
+    void saveAppointments()
+    {
+        if (replica || !appointmentsChanged)
+        {
+            return;
+        }
+
+        string buffer = "Doctor ID,Patient ID,Booked At\n";
+        doctors.forEach([&buffer](Doctor &d)
+                        {
+                            const AppointmentQueue &queued = d.getAppointments();
+                            for (size_t i = 0; i < queued.size(); i++)
+                                buffer += to_string(d.getId()) + "," + to_string(queued.at(i).patientId) + "," +
+                                          to_string(queued.at(i).bookedAt) + "\n"; });
+
+        ofstream file(APPOINTMENT_FILE, ios::binary | ios::trunc);
+        if (!file.is_open() || !file.write(buffer.data(), buffer.size()))
+        {
+            cerr << "Error: Could not write " << APPOINTMENT_FILE << ".\n";
+            return;
+        }
+        appointmentsChanged = false;
+    }
+
+    // Load patient data from file into memory.
+    // Expected CSV format: ID,Name,Age,Contact,AdmissionStatus,RoomType
+    void loadPatients()
+    {
+        if (LAZY_PATIENT_LOADING)
+        {
+            indexPatients();
+            return;
+        }
+
+        ifstream file(PATIENT_FILE);
+        if (!file.is_open())
+        {
+            cerr << "Error opening patient file.\n";
+            return;
+        }
+
+        long long width, rows;
+        loadPatients(file, width, rows);
+        file.close();
+        patientFile.adoptLayout(width, rows);
+        loadPatientIndex(false);
+    }
+
+    // Parses patient rows after the header line. width receives the common row
+    // width (0 if rows differ or any row was skipped) and rows the line count.
+    void loadPatients(istream &file, long long &width, long long &rows)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        string line;
+        getline(file, line);
+
+        width = -1;
+        rows = 0;
+        while (getline(file, line))
+        {
+            width = (width == -1 || width == (long long)line.size() + 1) ? line.size() + 1 : 0;
+            rows++;
+            line = trimRight(line);
+
+            optional<Patient> p = parsePatient(line);
+            if (!p)
+            {
+                cerr << "Skipping bad line: " << line << endl;
+                width = 0; // Row numbers no longer match the file
+                continue;
+            }
+
+            if (patients.add(*p, false) == nullptr)
+            {
+                cerr << "Skipping duplicate patient ID: " << line << endl;
+                width = 0;
+                continue;
+            }
+            if (p->getId() > patientCounter) // Rows are not in ID order once patients were removed
+                patientCounter = p->getId();
+        }
+        width = max(width, 0LL);
+    }
+
+    // One patient row; nothing if a required field is missing or not a number,
+    // the ID is not positive or the age is negative.
+    static optional<Patient> parsePatient(const string &line)
+    {
+        stringstream ss(line);
+        string idStr, name, ageStr, contact, admittedStr, roomStr;
+        getline(ss, idStr, ',');
+        getline(ss, name, ',');
+        getline(ss, ageStr, ',');
+        getline(ss, contact, ',');
+        getline(ss, admittedStr, ',');
+        getline(ss, roomStr);
+
+        int id, age;
+        if (!parseInt(idStr, id) || id <= 0 || name.empty() || !parseInt(ageStr, age) || age < 0 || admittedStr.empty())
+        {
+            return nullopt;
+        }
+
+        bool admitted = (admittedStr == "Admitted");
+
+        Patient p(id, name, age, contact);
+
+        if (admitted)
+        {
+            p.admitPatient(EnumTable<RoomType>::parse(roomStr, GENERAL_WARD));
+        }
+        return p;
+    }
+
+    // Reads the patient row at the given offset of the patient file (lazy loading).
+    optional<Patient> readPatientAt(long long offset)
+    {
+        if (!patientReader.is_open())
+        {
+            patientReader.open(PATIENT_FILE, ios::binary);
+        }
+
+        string line;
+        patientReader.clear();
+        if (!patientReader.seekg(offset) || !getline(patientReader, line))
+        {
+            cerr << "Error: Could not read patient record at offset " << offset << ".\n";
+            return nullopt;
+        }
+
+        line = trimRight(line);
+        optional<Patient> p = parsePatient(line);
+        if (!p)
+        {
+            cerr << "Skipping bad line: " << line << endl;
+        }
+        return p;
+    }
+
+    // Registers every patient by ID and row offset without parsing the rows:
+    // from the saved index when it still matches the file, else by one scan.
+    void indexPatients()
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        patients.loadEntity = [this](long long offset)
+        { return readPatientAt(offset); };
+        patients.rescanOffsets = [this]()
+        { return rescanPatientOffsets(); };
+        if (loadPatientIndex(true))
+        {
+            return;
+        }
+
+        long long width, rows;
+        bool scanned = scanPatientRows([this](int id, long long offset)
+                                       {
+                                           if (!patients.addLazy(id, offset))
+                                               return false;
+                                           patientCounter = max(patientCounter, id);
+                                           return true; },
+                                       width, rows);
+        if (!scanned)
+        {
+            cerr << "Error opening patient file.\n";
+            return;
+        }
+
+        patientFile.adoptLayout(width, rows);
+        savePatientIndex();
+    }
+
+    // Calls visit(id, offset) for each patient row without parsing the rest of
+    // it; width and rows as in loadPatients. False if the file cannot be read.
+    template <typename F>
+    bool scanPatientRows(F visit, long long &width, long long &rows)
+    {
+        ifstream file(PATIENT_FILE, ios::binary);
+        string line;
+        if (!file.is_open() || !getline(file, line))
+        {
+            return false;
+        }
+
+        long long offset = line.size() + 1;
+        width = -1;
+        rows = 0;
+        while (getline(file, line))
+        {
+            long long lineWidth = line.size() + 1;
+            width = (width == -1 || width == lineWidth) ? lineWidth : 0;
+            rows++;
+
+            int id;
+            if (!parseInt(line.substr(0, line.find(',')), id) || id <= 0 || !visit(id, offset))
+            {
+                cerr << "Skipping bad line: " << trimRight(line) << endl;
+                width = 0; // Row numbers no longer match the file
+            }
+            offset += lineWidth;
+        }
+        width = max(width, 0LL);
+        return true;
+    }
+
+    // A lazy row held another patient, so the saved ID list was out of date:
+    // it is discarded and the rows found again by scanning the patient file.
+    unordered_map<int, long long> rescanPatientOffsets()
+    {
+        cerr << "Warning: " << PATIENT_INDEX_FILE << " does not match " << PATIENT_FILE << ", rescanning it.\n";
+        unordered_map<int, long long> offsets;
+        long long width, rows;
+        scanPatientRows([&offsets](int id, long long offset)
+                        { return offsets.emplace(id, offset).second; },
+                        width, rows);
+
+        // The registry rows follow the stale list: rewrite the whole file on the next save
+        patientFile.adoptLayout(0, rows);
+        discardPatientIndex();
+        return offsets;
+    }
+
+    // patients.idx: "HMSI" | highest patient ID ever issued (u32) | patient file size (u64) |
+    // its modification time (u64) | row width (u64) | row count (u64) | patient ID of each row (u32 each)
+    bool patientFileStamp(unsigned long long &size, unsigned long long &modified)
+    {
+        error_code error;
+        size = filesystem::file_size(PATIENT_FILE, error);
+        if (error)
+        {
+            return false;
+        }
+        modified = filesystem::last_write_time(PATIENT_FILE, error).time_since_epoch().count();
+        return !error;
+    }
+
+    // The highest issued ID is always taken, so IDs of removed patients are never
+    // reused; the ID list only when asked for and while it matches the patient file.
+    bool loadPatientIndex(bool withRows)
+    {
+        unsigned long long size, modified;
+        ifstream file(PATIENT_INDEX_FILE, ios::binary);
+        char header[40];
+        if (!file.read(header, sizeof(header)) || string(header, 4) != "HMSI")
+        {
+            return false;
+        }
+
+        savedPatientCounter = getU32(header + 4);
+        patientCounter = max(patientCounter, savedPatientCounter);
+        if (!withRows || !patientFileStamp(size, modified) || getU64(header + 8) != size || getU64(header + 16) != modified)
+        {
+            return false; // The patient file changed since the list was written
+        }
+
+        long long width = getU64(header + 24);
+        long long rows = getU64(header + 32);
+        if (width <= 1 || rows < 0 || patientFile.getDataOffset() + rows * width != (long long)size)
+        {
+            return false;
+        }
+
+        string ids(rows * 4, '\0');
+        if (!file.read(&ids[0], ids.size()))
+        {
+            return false;
+        }
+
+        for (long long row = 0; row < rows; row++)
+        {
+            int id = getU32(ids.data() + row * 4);
+            if (!patients.addLazy(id, patientFile.getDataOffset() + row * width))
+            {
+                cerr << "Skipping duplicate patient ID in " << PATIENT_INDEX_FILE << ": " << id << endl;
+                width = 0; // Forces a full rewrite on the next save
+            }
+            else if (id > patientCounter)
+            {
+                patientCounter = id;
+            }
+        }
+        patientFile.adoptLayout(width, rows);
+        return true;
+    }
+
+    // Written only while the registry rows match the file rows exactly.
+    void savePatientIndex()
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        unsigned long long size, modified;
+        if (!patientFile.hasLayout() || patients.hasUnsavedRows() || patients.rowCount() != patientFile.getRowCount() ||
+            !patientFileStamp(size, modified))
+        {
+            return;
+        }
+
+        string out = "HMSI";
+        putU32(out, patientCounter);
+        putU64(out, size);
+        putU64(out, modified);
+        putU64(out, patientFile.getRowWidth());
+        putU64(out, patients.rowCount());
+        for (int id : patients.getRowIds())
+        {
+            putU32(out, id);
+        }
+
+        ofstream file(PATIENT_INDEX_FILE, ios::binary | ios::trunc);
+        if (!file.write(out.data(), out.size()))
+        {
+            cerr << "Error: Could not write " << PATIENT_INDEX_FILE << ".\n";
+            return;
+        }
+        savedPatientCounter = patientCounter;
+    }
+
+    // Stores a new highest issued ID right away. The ID list is left as it is:
+    // the patient file was just saved, so it no longer matches anyway.
+    void savePatientCounter()
+    {
+        string id;
+        putU32(id, patientCounter);
+
+        fstream file(PATIENT_INDEX_FILE, ios::in | ios::out | ios::binary);
+        char magic[4];
+        if (!file.is_open() || !file.read(magic, sizeof(magic)) || string(magic, 4) != "HMSI")
+        {
+            discardPatientIndex();
+            return;
+        }
+
+        file.seekp(4);
+        if (!file.write(id.data(), id.size()))
+        {
+            cerr << "Error: Could not write " << PATIENT_INDEX_FILE << ".\n";
+            return;
+        }
+        savedPatientCounter = patientCounter;
+    }
+
+    // Keeps only the highest issued ID in patients.idx; the ID list is written
+    // again once the patient file matches the registry rows.
+    void discardPatientIndex()
+    {
+        string header = "HMSI";
+        putU32(header, patientCounter);
+        header += string(32, '\0'); // Empty stamp: no ID list
+
+        ofstream file(PATIENT_INDEX_FILE, ios::binary | ios::trunc);
+        if (!file.write(header.data(), header.size()))
+        {
+            cerr << "Error: Could not write " << PATIENT_INDEX_FILE << ".\n";
+            return;
+        }
+        savedPatientCounter = patientCounter;
+    }
+
+    void loadDoctors()
+    {
+        ifstream file(DOCTOR_FILE);
+        if (!file.is_open())
+        {
+            cerr << "Error opening doctors file.\n";
+            return;
+        }
+
+        unordered_map<int, vector<Appointment>> queued;
+        ifstream appointments(APPOINTMENT_FILE);
+        if (appointments.is_open())
+        {
+            queued = loadAppointments(appointments);
+        }
+
+        long long width, rows;
+        loadDoctors(file, width, rows, queued);
+        file.close();
+        doctorFile.adoptLayout(width, rows);
+    }
+
+    // queued holds the appointments of each doctor ID, as read by loadAppointments().
+    void loadDoctors(istream &file, long long &width, long long &rows, const unordered_map<int, vector<Appointment>> &queued = {})
+    {
+        string line;
+        getline(file, line); // Skip header
+
+        width = -1;
+        rows = 0;
+        int droppedAppointments = 0;
+        while (getline(file, line))
+        {
+            width = (width == -1 || width == (long long)line.size() + 1) ? line.size() + 1 : 0;
+            rows++;
+            line = trimRight(line);
+
+            if (line.empty())
+            {
+                width = 0; // Blank lines break the fixed-width layout
+                continue;  // Skip empty lines
+            }
+
+            stringstream ss(line);
+            string idStr, name, deptStr, countStr;
+
+            getline(ss, idStr, ',');
+            getline(ss, name, ',');
+            getline(ss, deptStr, ',');
+            getline(ss, countStr, ',');
+
+            int id, count;
+            if (!parseInt(idStr, id) || id <= 0 || name.empty() || deptStr.empty() || !parseInt(countStr, count))
+            {
+                cerr << "Skipping bad line: " << line << endl;
+                width = 0; // Row numbers no longer match the file
+                continue;
+            }
+
+            Department dept = EnumTable<Department>::parse(deptStr, GENERAL);
+            Doctor doc(id, name, dept);
+
+            auto waiting = queued.find(id);
+            if (waiting != queued.end())
+            {
+                for (const Appointment &appointment : waiting->second)
+                    doc.addAppointment(appointment.patientId, appointment.bookedAt);
+            }
+
+            // Older files only stored a count, which cannot be turned back into a queue
+            droppedAppointments += max(0, count - doc.getAppointmentCount());
+
+            if (doctors.add(doc, false) == nullptr)
+            {
+                cerr << "Skipping duplicate doctor ID: " << line << endl;
+                width = 0;
+                continue;
+            }
+            if (id > doctorCounter)
+                doctorCounter = id;
+        }
+        width = max(width, 0LL);
+
+        if (droppedAppointments > 0)
+        {
+            cerr << "Warning: " << droppedAppointments << " appointments in " << DOCTOR_FILE
+                 << " have no queue entries and were not restored.\n";
+        }
+    }
+
+    // Reads appointments.csv rows (Doctor ID,Patient ID,Booked At) grouped by doctor, in queue order.
+    unordered_map<int, vector<Appointment>> loadAppointments(istream &file)
+    {
+        unordered_map<int, vector<Appointment>> queued;
+        string line;
+        getline(file, line); // Skip header
+
+        while (getline(file, line))
+        {
+            line = trimRight(line);
+            stringstream ss(line);
+            string doctorStr, patientStr, bookedStr;
+            getline(ss, doctorStr, ',');
+            getline(ss, patientStr, ',');
+            getline(ss, bookedStr);
+
+            int doctorId, patientId;
+            long long bookedAt;
+            if (!parseInt(doctorStr, doctorId) || !parseInt(patientStr, patientId) || !parseLong(bookedStr, bookedAt))
+            {
+                cerr << "Skipping bad line: " << line << endl;
+                continue;
+            }
+            queued[doctorId].push_back({patientId, bookedAt});
+        }
+        return queued;
+    }
+
+    // The new patient ID, or -1 once every ID has been issued.
+    int registerPatient(string name, int age, string contact)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        if (patientCounter == INT_MAX)
+        {
+            cout << "ERROR: No patient IDs left." << endl;
+            return -1;
+        }
+
+        record(makeEvent(PATIENT_REGISTERED, patientCounter + 1, 0, age, name, contact));
+        savePatients();
+        return patientCounter;
+    }
+
+    // The new doctor ID, or -1 once every ID has been issued.
+    int addDoctor(string name, Department dept)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        if (doctorCounter == INT_MAX)
+        {
+            cout << "ERROR: No doctor IDs left." << endl;
+            return -1;
+        }
+
+        record(makeEvent(DOCTOR_ADDED, doctorCounter + 1, 0, dept, name));
+        saveDoctors();
+        return doctorCounter;
+    }
+
+    // Removes a patient record (with their in-memory history), their appointments and emergency case.
+    void removePatient(int patientId)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        Patient *patient = patients.find(patientId);
+        if (patient == nullptr)
+        {
+            cout << "ERROR: Patient ID '" << patientId << "' not found." << endl;
+            return;
+        }
+
+        if (!patients.canRemove(patientId))
+        {
+            cout << "ERROR: Patient '" << patient->getName() << "' cannot be removed: another record could not be read." << endl;
+            return;
+        }
+
+        string name = patient->getName();
+        record(makeEvent(PATIENT_REMOVED, patientId));
+        cout << "Patient '" << name << "' has been removed.\n";
+    }
+
+    void admitPatient(int patientId, RoomType type)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        Patient *patient = patients.find(patientId);
+        if (patient == nullptr)
+        {
+            cout << "ERROR: Patient ID '" << patientId << "' not found." << endl;
+            return;
+        }
+
+        if (patient->getAdmissionStatus())
+        {
+            cout << "ERROR: Patient '" << patient->getName() << "' is already admitted." << endl;
+        }
+        else
+        {
+            record(makeEvent(PATIENT_ADMITTED, patientId, 0, type));
+            cout << "Patient '" << patient->getName()
+                 << "' is admitted to " << patient->roomString(type) << "." << endl;
+        }
+    }
+
+    void addEmergency(int patientId)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        Patient *p = patients.find(patientId);
+        if (p == nullptr)
+        {
+            cout << "ERROR: Patient ID not found, please register first." << endl;
+            return;
+        }
+
+        record(makeEvent(EMERGENCY_ADDED, patientId));
+        cout << "Patient '" << p->getName() << "' added to emergency queue." << endl;
+        // savePatients();
+    }
+
+    int handleEmergency()
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        if (emergencyQueue.empty())
+        {
+            cout << "No emergency cases in queue." << endl;
+            return -1;
+        }
+
+        int patientId = emergencyQueue.front();
+        record(makeEvent(EMERGENCY_HANDLED, patientId));
+
+        Patient *p = patients.find(patientId);
+        if (p != nullptr)
+        {
+            cout << "Emergency handled for patient '" << p->getName() << "'." << endl;
+        }
+        // savePatients();
+        return patientId;
+    }
+
+    void bookAppointment(int doctorId, int patientId)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        Doctor *d = doctors.find(doctorId);
+        if (d == nullptr)
+        {
+            cout << "ERROR: Doctor ID '" << doctorId << "' not found." << endl;
+            return;
+        }
+
+        Patient *p = patients.find(patientId);
+        if (p == nullptr)
+        {
+            cout << "ERROR: Patient ID '" << patientId << "' not found." << endl;
+            return;
+        }
+
+        record(makeEvent(APPOINTMENT_BOOKED, doctorId, patientId));
+        cout << "Patient '" << p->getName() << "' booked appointment with " << d->getName() << "." << endl;
+    }
+
+    void displayPatientInfo(int patientId)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        Patient *p = patients.find(patientId);
+        if (p == nullptr)
+        {
+            cout << "ERROR: Patient ID '" << patientId << "' not found." << endl;
+            return;
+        }
+
+        cout << "\n========= Patient Information =========\n";
+        cout << "ID : " << p->getId() << endl;
+        cout << "Name : " << p->getName() << endl;
+        cout << "Age : " << p->getAge() << endl;
+        cout << "Contact : " << p->getContact() << endl;
+        cout << "Admission Status : " << (p->getAdmissionStatus() ? "Admitted" : "Not Admitted") << endl;
+        cout << "Room Type : " << p->getRoomTypeAsString() << endl;
+
+        p->displayHistory();
+    }
+
+    void displayDoctorInfo(int doctorId)
+    {
+        Doctor *d = doctors.find(doctorId);
+        if (d == nullptr)
+        {
+            cout << "ERROR: Doctor ID '" << doctorId << "' not found." << endl;
+            return;
+        }
+
+        cout << "\n========= Doctor Information =========\n";
+        cout << "ID : " << d->getId() << endl;
+        cout << "Name : " << d->getName() << endl;
+        cout << "Department : " << d->getDepartment() << endl;
+        cout << "Pending Appointments : " << d->getAppointmentCount() << endl;
+        cout << "Peak Queue Length : " << d->getPeakQueueLength() << endl;
+
+        const Histogram &lengths = d->getQueueLengthStats();
+        if (lengths.getSamples() > 0)
+        {
+            cout << "Queue Length p50/p90/p99 : <= " << lengths.percentile(50) << " / <= "
+                 << lengths.percentile(90) << " / <= " << lengths.percentile(99) << endl;
+        }
+
+        const Histogram &waits = d->getWaitStats();
+        cout << "Patients Seen : " << waits.getSamples() << endl;
+        if (waits.getSamples() > 0)
+        {
+            cout << "Waiting Time p50/p90/p99 : <= " << waits.percentile(50) << "s / <= "
+                 << waits.percentile(90) << "s / <= " << waits.percentile(99) << "s" << endl;
+        }
+        cout << endl;
+    }
+
+    // Doctors with the longest queues, to spot overloaded doctors.
+    void displayBusiestDoctors(size_t limit)
     {
-        ofstream file(PATIENT_FILE);
-        if (!file.is_open())
+        vector<Doctor *> ranked;
+        doctors.forEach([&ranked](Doctor &d)
+                        {
+                            if (d.getAppointmentCount() > 0)
+                                ranked.push_back(&d); });
+
+        limit = min(limit, ranked.size());
+        partial_sort(ranked.begin(), ranked.begin() + limit, ranked.end(), [](Doctor *a, Doctor *b)
+                     { return a->getAppointmentCount() > b->getAppointmentCount(); });
+
+        cout << "\n========= Busiest Doctors =========\n";
+        if (limit == 0)
         {
-            cerr << "Error: Could not open " << PATIENT_FILE << " for writing.\n";
-            return;
+            cout << "No pending appointments.\n";
         }
-
-        file << "ID,Name,Age,Contact,Admission Status,Room Type\n";
-        for (auto &p : patients)
+        for (size_t i = 0; i < limit; i++)
         {
-            file << p.getId() << ","
-                 << p.getName() << ","
-                 << p.getAge() << ","
-                 << p.getContact() << ","
-                 << (p.getAdmissionStatus() ? "Admitted" : "Not Admitted") << ","
-                 << p.getRoomTypeAsString() << "\n";
+            Doctor *d = ranked[i];
+            long long p90 = d->getWaitStats().percentile(90);
+            cout << d->getId() << " - " << d->getName() << " : " << d->getAppointmentCount() << " waiting";
+            if (p90 >= 0)
+                cout << ", p90 wait <= " << p90 << "s";
+            cout << endl;
         }
-
-        file.close();
+        cout << endl;
     }
 
-    void saveDoctors()
+    void dischargePatient(int patientId)
     {
-        ofstream file(DOCTOR_FILE);
-        if (!file.is_open())
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        Patient *patient = patients.find(patientId);
+        if (patient == nullptr)
         {
-            cerr << "Error: Could not open " << DOCTOR_FILE << " for writing.\n";
+            cout << "ERROR: Patient ID '" << patientId << "' not found.\n";
             return;
         }
 
-        file << "ID,Name,Department,Appointment\n";
-
-        for (auto &d : doctors)
+        if (!patient->getAdmissionStatus())
         {
-            file << d.getId() << ","
-                 << d.getName() << ","
-                 << d.getDepartment() << ","
-                 << d.getAppointmentCount() << "\n";
+            cout << "ERROR: Patient '" << patient->getName() << "' is not admitted.\n";
+            return;
         }
 
-        file.close();
+        record(makeEvent(PATIENT_DISCHARGED, patientId));
+        cout << "Patient '" << patient->getName() << "' has been discharged.\n";
     }
 
-    // Load patient data from file into memory.
-    // Expected CSV format: ID,Name,Age,Contact,AdmissionStatus
-    void loadPatients()
+    void requestTest(int patientId, string testName)
     {
-        ifstream file(PATIENT_FILE);
-        if (!file.is_open())
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        Patient *patient = patients.find(patientId);
+        if (patient == nullptr)
         {
-            cerr << "Error opening patient file.\n";
+            cout << "ERROR: Patient ID '" << patientId << "' not found." << endl;
             return;
         }
 
-        string line;
-        getline(file, line);
-
-        while (getline(file, line))
-        {
-            stringstream ss(line);
-            string idStr, name, ageStr, contact, admittedStr, roomStr;
-            getline(ss, idStr, ',');
-            getline(ss, name, ',');
-            getline(ss, ageStr, ',');
-            getline(ss, contact, ',');
-            getline(ss, admittedStr, ',');
-            getline(ss, roomStr);
-
-            int id = stoi(idStr);
-            int age = stoi(ageStr);
-            bool admitted = (admittedStr == "Admitted");
-
-            Patient p(id, name, age, contact);
-
-            if (admitted)
-            {
-                RoomType room = GENERAL_WARD;
-                if (roomStr == "ICU")
-                    room = ICU;
-                else if (roomStr == "Private Room")
-                    room = PRIVATE_ROOM;
-                else if (roomStr == "Semi-Private Room")
-                    room = SEMI_PRIVATE;
-                else if (roomStr == "General Ward")
-                    room = GENERAL_WARD;
-
-                p.admitPatient(room);
-            }
+        record(makeEvent(TEST_REQUESTED, patientId, 0, 0, testName));
+        lab.submit(patientId, testName);
+        cout << "Test '" << testName << "' requested for patient '" << patient->getName() << "'.\n";
+    }
 
-            patients.push_back(p);
-            patientCounter = id;
-        }
+    void displayLabStats()
+    {
+        lab.displayStats();
+    }
 
-        file.close();
+    void displaySummary(string title)
+    {
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        int admitted = 0, appointments = 0;
+
+        cout << "\n========= " << title << " =========\n";
+        patients.forEach([&admitted](Patient &p)
+                         {
+                             if (p.getAdmissionStatus())
+                             {
+                                 admitted++;
+                                 cout << "Admitted : " << p.getId() << " - " << p.getName() << " (" << p.getRoomTypeAsString() << ")" << endl;
+                             } });
+        doctors.forEach([&appointments](Doctor &d)
+                        { appointments += d.getAppointmentCount(); });
+
+        cout << "Patients : " << patients.size() << endl;
+        cout << "Admitted Patients : " << admitted << endl;
+        cout << "Doctors : " << doctors.size() << endl;
+        cout << "Pending Appointments : " << appointments << endl;
+        cout << "Emergency Queue : " << emergencyQueue.size() << endl
+             << endl;
     }
 
-    void loadDoctors()
+    void seePatient(int doctorId)
     {
-        ifstream file(DOCTOR_FILE);
-        if (!file.is_open())
+        lock_guard<recursive_mutex> lock(patientsMutex);
+        Doctor *d = doctors.find(doctorId);
+        if (d == nullptr)
         {
-            cerr << "Error opening doctors file.\n";
+            cout << "ERROR: Doctor ID '" << doctorId << "' not found.\n";
             return;
         }
 
-        string line;
-        getline(file, line); // Skip header
-
-        while (getline(file, line))
+        int patientId = d->nextPatient();
+        if (patientId == -1)
         {
-            if (line.empty())
-                continue; // Skip empty lines
-
-            stringstream ss(line);
-            string idStr, name, deptStr, countStr;
-
-            getline(ss, idStr, ',');
-            getline(ss, name, ',');
-            getline(ss, deptStr, ',');
-            getline(ss, countStr);
-
-            if (idStr.empty() || name.empty() || deptStr.empty() || countStr.empty())
-            {
-                cerr << "Skipping bad line: " << line << endl;
-                continue;
-            }
-
-            int id = stoi(idStr);
-            int count = stoi(countStr);
+            cout << "No patients in queue for " << d->getName() << ".\n";
+        }
+        else
+        {
+            record(makeEvent(PATIENT_SEEN, doctorId));
+            cout << d->getName() << " is now seeing patient with ID: " << patientId << ".\n";
+        }
+    }
+};
 
-            Department dept = GENERAL;
-            if (deptStr == "Cardiology")
-                dept = CARDIOLOGY;
-            else if (deptStr == "Neurology")
-                dept = NEUROLOGY;
-            else if (deptStr == "Orthopedics")
-                dept = ORTHOPEDICS;
-            else if (deptStr == "Pediatrics")
-                dept = PEDIATRICS;
-            else if (deptStr == "Emergency")
-                dept = EMERGENCY;
+// ========== DATA EXPORT ========== //
+// Streams patients, doctors, medical history and queues to JSON lines and to
+// a columnar binary format. Output goes through fixed-size write buffers and
+// history is paged in one archive block at a time, so memory use does not
+// depend on the size of the data set.
+const size_t EXPORT_CHUNK_SIZE = 1 << 20;
+const int EXPORT_ROW_GROUP_SIZE = 65536;
 
-            // Doctor doc(id, name, dept);      XXX when adding a new doc. all appointments are set to 0.
-            Doctor doc(id, name, dept, count);
+// Buffered output file that is written in EXPORT_CHUNK_SIZE chunks.
+class ChunkedWriter
+{
+private:
+    string path;
+    ofstream file;
+    string buffer;
+    long long written;
 
-            doctors.push_back(doc);
-            if (id > doctorCounter)
-                doctorCounter = id;
+public:
+    ChunkedWriter(string p) : path(p), file(p, ios::binary | ios::trunc)
+    {
+        written = 0;
+        buffer.reserve(EXPORT_CHUNK_SIZE);
+        if (!file.is_open())
+        {
+            cerr << "Error: Could not open " << path << " for writing.\n";
         }
-
-        file.close();
     }
 
-    int registerPatient(string name, int age, string contact)
+    ~ChunkedWriter()
     {
-        Patient newPatient(++patientCounter, name, age, contact);
-        patients.push_back(newPatient);
-        savePatients();
-        return patientCounter;
+        flush();
     }
 
-    int addDoctor(string name, Department dept)
+    void write(const string &data)
     {
-        Doctor newDoctor(++doctorCounter, name, dept);
-        doctors.push_back(newDoctor);
-        saveDoctors();
-        return doctorCounter;
+        buffer += data;
+        if (buffer.size() >= EXPORT_CHUNK_SIZE)
+            flush();
     }
 
-    void admitPatient(int patientId, RoomType type)
+    // False once opening or writing the file has failed; reported only the first time.
+    bool flush()
     {
-        for (auto &patient : patients)
+        bool wasGood = file.good();
+        file.write(buffer.data(), buffer.size());
+        written += buffer.size();
+        buffer.clear();
+        if (wasGood && !file)
         {
-            if (patient.getId() == patientId)
-            {
-                if (patient.getAdmissionStatus())
-                {
-                    cout << "ERROR: Patient '" << patient.getName() << "' is already admitted." << endl;
-                }
-                else
-                {
-                    patient.admitPatient(type);
-                    cout << "Patient '" << patient.getName()
-                         << "' is admitted to " << patient.roomString(type) << "." << endl;
-                }
-                return;
-            }
+            cerr << "Error: Could not write " << path << ".\n";
         }
+        return (bool)file;
+    }
 
-        cout << "ERROR: Patient ID '" << patientId << "' not found." << endl;
+    long long bytesWritten()
+    {
+        return written + buffer.size();
     }
+};
 
-    void addEmergency(int patientId)
+string jsonString(const string &text)
+{
+    string out = "\"";
+    for (unsigned char c : text)
     {
-        for (Patient &p : patients)
+        if (c == '"' || c == '\\')
         {
-            if (patientId == p.getId())
-            {
-                emergencyQueue.push(patientId);
-                p.addMedicalRecord("Marked as Emergency Case on " + getCurrentDateTime());
-                cout << "Patient '" << p.getName() << "' added to emergency queue." << endl;
-                // savePatients();
-                return;
-            }
+            out += '\\';
+            out += c;
+        }
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else
+        {
+            out += c;
         }
+    }
+    return out + "\"";
+}
 
-        cout << "ERROR: Patient ID not found, please register first." << endl;
+// Splits a history record into its event text and time ("" when it has none).
+void splitRecord(const string &record, string &event, string &time)
+{
+    long long seconds;
+    size_t split = record.rfind(" on ");
+    if (split != string::npos && parseDateTime(record.substr(split + 4), seconds))
+    {
+        event = record.substr(0, split);
+        time = record.substr(split + 4);
     }
+    else
+    {
+        event = record;
+        time = "";
+    }
+}
 
-    int handleEmergency()
+// Columnar table file. Layout:
+//   "HMSC" | column count (u32) | per column: type (u8, 0 = integer, 1 = string), name
+//   row groups: row count (u32) | per column: byte length (u32) + values
+//   footer: row group offsets (u64 each) | row group count (u32) | footer offset (u64) | "HMSC"
+// Integers are zigzag varints, strings are length-prefixed.
+class ColumnarWriter
+{
+private:
+    ChunkedWriter out;
+    vector<bool> isString;
+    vector<string> columns; // Values of the current row group
+    vector<long long> groupOffsets;
+    int rows;
+    size_t column;
+
+    void flushGroup()
     {
-        if (emergencyQueue.empty())
+        if (rows == 0)
+            return;
+
+        string group;
+        groupOffsets.push_back(out.bytesWritten());
+        putU32(group, rows);
+        for (string &values : columns)
         {
-            cout << "No emergency cases in queue." << endl;
-            return -1;
+            putU32(group, values.size());
+            group += values;
+            values.clear();
         }
+        out.write(group);
+        rows = 0;
+    }
 
-        int patientId = emergencyQueue.front();
-        emergencyQueue.pop();
+public:
+    long long rowsWritten;
 
-        for (Patient &p : patients)
+    ColumnarWriter(string path, const vector<pair<string, bool>> &schema) : out(path)
+    {
+        string header = "HMSC";
+        putU32(header, schema.size());
+        for (auto &col : schema)
         {
-            if (p.getId() == patientId)
-            {
-                p.addMedicalRecord("Emergency Case Handled on " + getCurrentDateTime());
-                cout << "Emergency handled for patient '" << p.getName() << "'." << endl;
-                break;
-            }
+            header.push_back(col.second ? 1 : 0);
+            putString(header, col.first);
+            isString.push_back(col.second);
         }
-        // savePatients();
-        return patientId;
+        out.write(header);
+        columns.resize(schema.size());
+        rows = 0;
+        column = 0;
+        rowsWritten = 0;
     }
 
-    void bookAppointment(int doctorId, int patientId)
+    ~ColumnarWriter()
     {
-        for (Doctor &d : doctors)
-        {
-            if (doctorId == d.getId())
-            {
-                for (Patient &p : patients)
-                {
-                    if (patientId == p.getId())
-                    {
-                        d.addAppointment(patientId);
-                        p.addMedicalRecord("Appointment booked with Doctor ID " + to_string(doctorId) + " on " + getCurrentDateTime());
-                        cout << "Patient '" << p.getName() << "' booked appointment with " << d.getName() << "." << endl;
-                        return;
-                    }
-                }
-                cout << "ERROR: Patient ID '" << patientId << "' not found." << endl;
-                return;
-            }
-        }
+        close();
+    }
 
-        cout << "ERROR: Doctor ID '" << doctorId << "' not found." << endl;
+    ColumnarWriter &add(long long value)
+    {
+        putSigned(columns[column++], value);
+        return *this;
     }
 
-    void displayPatientInfo(int patientId)
+    ColumnarWriter &add(const string &value)
     {
-        for (Patient &p : patients)
-        {
-            if (p.getId() == patientId)
-            {
-                cout << "\n========= Patient Information =========\n";
-                cout << "ID : " << p.getId() << endl;
-                cout << "Name : " << p.getName() << endl;
-                cout << "Age : " << p.getAge() << endl;
-                cout << "Contact : " << p.getContact() << endl;
-                cout << "Admission Status : " << (p.getAdmissionStatus() ? "Admitted" : "Not Admitted") << endl;
-                cout << "Room Type : " << p.getRoomTypeAsString() << endl;
+        putString(columns[column++], value);
+        return *this;
+    }
 
-                p.displayHistory();
+    void endRow()
+    {
+        column = 0;
+        rowsWritten++;
+        if (++rows == EXPORT_ROW_GROUP_SIZE)
+            flushGroup();
+    }
 
-                return;
-            }
-        }
+    // Writes the last row group and the footer once; false if the file could not be written.
+    bool close()
+    {
+        if (columns.empty())
+            return out.flush();
+
+        flushGroup();
+        string footer;
+        long long footerOffset = out.bytesWritten();
+        for (long long offset : groupOffsets)
+            putU64(footer, offset);
+        putU32(footer, groupOffsets.size());
+        putU64(footer, footerOffset);
+        footer += "HMSC";
+        out.write(footer);
+        columns.clear();
+        return out.flush();
+    }
+
+    long long bytesWritten()
+    {
+        return out.bytesWritten();
+    }
+};
+
+class DataExporter
+{
+public:
+    long long rows;
+    long long bytes;
+    double seconds;
 
-        cout << "ERROR: Patient ID '" << patientId << "' not found." << endl;
+    DataExporter()
+    {
+        rows = 0;
+        bytes = 0;
+        seconds = 0;
     }
 
-    void displayDoctorInfo(int doctorId)
+    // One JSON object per line, tagged with its "type". False if the file could not be written.
+    bool exportJsonLines(Hospital &hospital, string path)
     {
-        for (Doctor &d : doctors)
+        auto start = chrono::steady_clock::now();
+        ChunkedWriter out(path);
+        rows = 0;
+
+        hospital.forEachPatient([&](Patient &p)
+                                {
+                                    out.write("{\"type\":\"patient\",\"id\":" + to_string(p.getId()) +
+                                              ",\"name\":" + jsonString(p.getName()) +
+                                              ",\"age\":" + to_string(p.getAge()) +
+                                              ",\"contact\":" + jsonString(p.getContact()) +
+                                              ",\"admitted\":" + (p.getAdmissionStatus() ? "true" : "false") +
+                                              ",\"room\":" + jsonString(p.getRoomTypeAsString()) + "}\n");
+                                    rows++;
+
+                                    string event, time;
+                                    p.forEachRecord([&](const string &record)
+                                                    {
+                                                        splitRecord(record, event, time);
+                                                        out.write("{\"type\":\"history\",\"patientId\":" + to_string(p.getId()) +
+                                                                  ",\"time\":" + jsonString(time) +
+                                                                  ",\"event\":" + jsonString(event) + "}\n");
+                                                        rows++; }); });
+
+        hospital.forEachDoctor([&](Doctor &d)
+                               {
+                                   out.write("{\"type\":\"doctor\",\"id\":" + to_string(d.getId()) +
+                                             ",\"name\":" + jsonString(d.getName()) +
+                                             ",\"department\":" + jsonString(d.getDepartment()) +
+                                             ",\"pending\":" + to_string(d.getAppointmentCount()) + "}\n");
+                                   rows++;
+
+                                   const AppointmentQueue &queued = d.getAppointments();
+                                   for (size_t i = 0; i < queued.size(); i++)
+                                   {
+                                       out.write("{\"type\":\"appointment\",\"doctorId\":" + to_string(d.getId()) +
+                                                 ",\"position\":" + to_string(i) +
+                                                 ",\"patientId\":" + to_string(queued.at(i).patientId) +
+                                                 ",\"bookedAt\":" + jsonString(formatDateTime(queued.at(i).bookedAt)) + "}\n");
+                                       rows++;
+                                   } });
+
+        hospital.forEachEmergency([&](int position, int patientId)
+                                  {
+                                      out.write("{\"type\":\"emergency\",\"position\":" + to_string(position) +
+                                                ",\"patientId\":" + to_string(patientId) + "}\n");
+                                      rows++; });
+
+        bool saved = out.flush();
+        bytes = out.bytesWritten();
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return saved;
+    }
+
+    // One columnar file per table: <prefix>patients.col, doctors.col, history.col,
+    // appointments.col and emergencies.col. Timestamps are stored as seconds.
+    // False if any of the files could not be written.
+    bool exportColumnar(Hospital &hospital, string prefix)
+    {
+        auto start = chrono::steady_clock::now();
+        ColumnarWriter patients(prefix + "patients.col", {{"id", false}, {"name", true}, {"age", false}, {"contact", true}, {"admitted", false}, {"room", true}});
+        ColumnarWriter history(prefix + "history.col", {{"patientId", false}, {"time", false}, {"event", true}});
+        ColumnarWriter doctors(prefix + "doctors.col", {{"id", false}, {"name", true}, {"department", true}, {"pending", false}});
+        ColumnarWriter appointments(prefix + "appointments.col", {{"doctorId", false}, {"position", false}, {"patientId", false}, {"bookedAt", false}});
+        ColumnarWriter emergencies(prefix + "emergencies.col", {{"position", false}, {"patientId", false}});
+
+        hospital.forEachPatient([&](Patient &p)
+                                {
+                                    patients.add(p.getId()).add(p.getName()).add(p.getAge()).add(p.getContact())
+                                        .add(p.getAdmissionStatus() ? 1 : 0).add(p.getRoomTypeAsString()).endRow();
+
+                                    string event, time;
+                                    long long recordTime;
+                                    p.forEachRecord([&](const string &record)
+                                                    {
+                                                        splitRecord(record, event, time);
+                                                        if (time.empty() || !parseDateTime(time, recordTime))
+                                                            recordTime = 0;
+                                                        history.add(p.getId()).add(recordTime).add(event).endRow(); }); });
+
+        hospital.forEachDoctor([&](Doctor &d)
+                               {
+                                   doctors.add(d.getId()).add(d.getName()).add(d.getDepartment()).add(d.getAppointmentCount()).endRow();
+
+                                   const AppointmentQueue &queued = d.getAppointments();
+                                   for (size_t i = 0; i < queued.size(); i++)
+                                       appointments.add(d.getId()).add(i).add(queued.at(i).patientId).add(queued.at(i).bookedAt).endRow(); });
+
+        hospital.forEachEmergency([&](int position, int patientId)
+                                  { emergencies.add(position).add(patientId).endRow(); });
+
+        ColumnarWriter *tables[] = {&patients, &history, &doctors, &appointments, &emergencies};
+        rows = 0;
+        bytes = 0;
+        bool saved = true;
+        for (ColumnarWriter *table : tables)
         {
-            if (doctorId == d.getId())
-            {
-                cout << "\n========= Doctor Information =========\n";
-                cout << "ID : " << d.getId() << endl;
-                cout << "Name : " << d.getName() << endl;
-                cout << "Department : " << d.getDepartment() << endl;
-                cout << "Pending Appointments : " << d.getAppointmentCount() << endl
-                     << endl;
-                // Could Display Appointments too.
-                return;
-            }
+            saved = table->close() && saved;
+            rows += table->rowsWritten;
+            bytes += table->bytesWritten();
         }
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return saved;
+    }
+
+    void displayStats(string format)
+    {
+        cout << "Exported " << rows << " rows (" << bytes << " bytes) as " << format << " in " << seconds << " s";
+        if (seconds > 0)
+            cout << " (" << rows / seconds << " rows/s, " << bytes / seconds / (1 << 20) << " MB/s)";
+        cout << endl;
+    }
+};
 
-        cout << "ERROR: Doctor ID '" << doctorId << "' not found." << endl;
+// ========== EVENT REPLAY ========== //
+// Rebuilds the hospital state at a given time from the event log, starting
+// from the latest checkpoint taken before that time. Events are applied in
+// log order until the first one later than the requested time.
+class EventReplay
+{
+private:
+    struct Checkpoint
+    {
+        long long fileOffset;     // Where the snapshot is stored in the checkpoint file
+        long long payloadSize;    // Size of the snapshot
+        long long logOffset;      // Next event to apply after the snapshot
+        long long previous;       // Timestamp that event is delta-encoded against
+        long long maxTimestamp;   // Latest event time included in the snapshot
+        long long eventCount;     // Events included in the snapshot
+    };
+
+    // Bytes hashed at the start of the log (its identity) and before logOffset.
+    static const int STAMP_BYTES = 64;
+
+    string logPath;
+    string checkpointPath;
+    vector<Checkpoint> checkpoints;
+
+    // Hash of the log bytes [from, to); false if the log is shorter.
+    bool hashLog(long long from, long long to, unsigned int &hash)
+    {
+        ifstream file(logPath, ios::binary);
+        string bytes(to - from, '\0');
+        if (!file.seekg(from) || !file.read(&bytes[0], bytes.size()))
+            return false;
+        hash = fnv1a(bytes, 0);
+        return true;
     }
 
-    void dischargePatient(int patientId)
+    // Stamp tying a checkpoint to the log it was taken from: the start of the
+    // log and the bytes just before the checkpoint's logOffset.
+    bool stampLog(long long logOffset, unsigned int &identity, unsigned int &tail)
     {
-        for (Patient &patient : patients)
+        return hashLog(0, min<long long>(STAMP_BYTES, logOffset), identity) &&
+               hashLog(max<long long>(0, logOffset - STAMP_BYTES), logOffset, tail);
+    }
+
+    // Checkpoint record: [payload size u32][logOffset][previous][maxTimestamp][eventCount] (u64 each)
+    // [log identity][log tail] (u32 each) + payload. Checkpoints of another or a
+    // shorter log (e.g. after events.log was deleted) are ignored.
+    void loadCheckpointIndex()
+    {
+        error_code error;
+        long long logSize = filesystem::file_size(logPath, error);
+        if (error)
+            logSize = 0;
+
+        ifstream file(checkpointPath, ios::binary);
+        char header[44];
+        int stale = 0;
+        while (file.read(header, sizeof(header)))
         {
-            if (patient.getId() == patientId)
-            {
-                if (!patient.getAdmissionStatus())
-                {
-                    cout << "ERROR: Patient '" << patient.getName() << "' is not admitted.\n";
-                    return;
-                }
+            Checkpoint checkpoint;
+            checkpoint.fileOffset = (long long)file.tellg();
+            checkpoint.payloadSize = getU32(header);
+            checkpoint.logOffset = getU64(header + 4);
+            checkpoint.previous = getU64(header + 12);
+            checkpoint.maxTimestamp = getU64(header + 20);
+            checkpoint.eventCount = getU64(header + 28);
+            if (!file.seekg(checkpoint.payloadSize, ios::cur))
+                break;
 
-                patient.dischargePatient();
-                cout << "Patient '" << patient.getName() << "' has been discharged.\n";
-                return;
+            unsigned int identity = 0, tail = 0;
+            if (checkpoint.logOffset <= 0 || checkpoint.logOffset > logSize ||
+                !stampLog(checkpoint.logOffset, identity, tail) ||
+                identity != getU32(header + 36) || tail != getU32(header + 40))
+            {
+                stale++;
+                continue;
             }
+            checkpoints.push_back(checkpoint);
         }
+        if (stale > 0)
+            cerr << "Warning: Ignoring " << stale << " checkpoints that do not match " << logPath << ".\n";
+    }
+
+    void writeCheckpoint(Hospital &state, Checkpoint checkpoint)
+    {
+        unsigned int identity = 0, tail = 0;
+        if (!stampLog(checkpoint.logOffset, identity, tail))
+            return;
 
-        cout << "ERROR: Patient ID '" << patientId << "' not found.\n";
+        string payload = state.serializeState();
+        string header;
+        putU32(header, payload.size());
+        putU64(header, checkpoint.logOffset);
+        putU64(header, checkpoint.previous);
+        putU64(header, checkpoint.maxTimestamp);
+        putU64(header, checkpoint.eventCount);
+        putU32(header, identity);
+        putU32(header, tail);
+        checkpoint.payloadSize = payload.size();
+
+        ofstream file(checkpointPath, ios::binary | ios::app);
+        file.seekp(0, ios::end);
+        checkpoint.fileOffset = (long long)file.tellp() + header.size();
+        file.write(header.data(), header.size());
+        file.write(payload.data(), payload.size());
+        if (file)
+            checkpoints.push_back(checkpoint);
     }
 
-    void requestTest(int patientId, string testName)
+public:
+    long long eventsApplied;
+    double seconds;
+
+    EventReplay(string log, string checkpointFile)
+    {
+        logPath = log;
+        checkpointPath = checkpointFile;
+        eventsApplied = 0;
+        seconds = 0;
+        loadCheckpointIndex();
+    }
+
+    unique_ptr<Hospital> stateAt(long long timestamp)
     {
-        for (auto &patient : patients)
+        auto start = chrono::steady_clock::now();
+        unique_ptr<Hospital> state(new Hospital(true));
+
+        Checkpoint from = {0, 0, 0, 0, LLONG_MIN, 0};
+        for (const Checkpoint &checkpoint : checkpoints)
+        {
+            if (checkpoint.maxTimestamp <= timestamp && checkpoint.eventCount > from.eventCount)
+                from = checkpoint;
+        }
+        if (from.eventCount > 0)
         {
-            if (patient.getId() == patientId)
+            ifstream file(checkpointPath, ios::binary);
+            string payload(from.payloadSize, '\0');
+            file.seekg(from.fileOffset);
+            if (!file.read(&payload[0], payload.size()) || !state->restoreState(payload))
             {
-                patient.requestTest(testName);
-                cout << "Test '" << testName << "' requested for patient '" << patient.getName() << "'.\n";
-                return;
+                cerr << "Error: Corrupt checkpoint, replaying from the start.\n";
+                state.reset(new Hospital(true));
+                from = {0, 0, 0, 0, LLONG_MIN, 0};
             }
         }
 
-        cout << "ERROR: Patient ID '" << patientId << "' not found." << endl;
-    }
-
-    void performTest(int patientId)
-    {
-        for (auto &patient : patients)
+        long long lastStored = checkpoints.empty() ? 0 : checkpoints.back().eventCount;
+        Checkpoint current = from;
+        EventReader reader(logPath, from.logOffset, from.previous);
+        HospitalEvent event;
+        eventsApplied = 0;
+        while (reader.next(event) && event.timestamp <= timestamp)
         {
-            if (patient.getId() == patientId)
+            state->apply(event);
+            eventsApplied++;
+            current.eventCount++;
+            current.maxTimestamp = max(current.maxTimestamp, event.timestamp);
+
+            if (current.eventCount % CHECKPOINT_INTERVAL == 0 && current.eventCount > lastStored)
             {
-                string result = patient.performTest();
-                cout << "Patient '" << patient.getName() << "' performed " << result << " test." << endl;
-                return;
+                current.logOffset = reader.offset();
+                current.previous = reader.previousTimestamp();
+                writeCheckpoint(*state, current);
+                lastStored = current.eventCount;
             }
         }
 
-        cout << "ERROR: Patient ID '" << patientId << "' not found." << endl;
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return state;
     }
 
-    void seePatient(int doctorId)
+    // Time-travel query: prints what the hospital looked like at the given time.
+    void displayStateAt(string dateTime)
     {
-        for (Doctor &d : doctors)
+        long long timestamp;
+        if (!parseDateTime(dateTime, timestamp))
         {
-            if (d.getId() == doctorId)
-            {
-                int patientId = d.seePatient();
-                if (patientId == -1)
-                {
-                    cout << "No patients in queue for " << d.getName() << ".\n";
-                }
-                else
-                {
-                    cout << d.getName() << " is now seeing patient with ID: " << patientId << ".\n";
-                }
-                return;
-            }
+            cout << "ERROR: Invalid date, expected YYYY-MM-DD HH:MM:SS.\n";
+            return;
         }
 
-        cout << "ERROR: Doctor ID '" << doctorId << "' not found.\n";
+        unique_ptr<Hospital> state = stateAt(timestamp);
+        state->displaySummary("Hospital State at " + dateTime);
+        cout << "Replayed " << eventsApplied << " events in " << seconds << " s ("
+             << (seconds > 0 ? eventsApplied / seconds : 0) << " events/s)\n\n";
     }
 };
 
@@ -667,6 +3651,8 @@ void run(Hospital &hospital)
         cout << "1. Patient Management\n";
         cout << "2. Doctor Management\n";
         cout << "3. Emergency Management\n";
+        cout << "4. Time-Travel Query\n";
+        cout << "5. Export Data\n";
         cout << "0. Exit\n";
         cout << "\n-> Enter your choice: ";
         cin >> mainChoice;
@@ -683,8 +3669,9 @@ void run(Hospital &hospital)
                 cout << "2. Admit Patient\n";
                 cout << "3. Discharge Patient\n";
                 cout << "4. Request Medical Test\n";
-                cout << "5. Perform Medical Test\n";
+                cout << "5. View Lab Pipeline\n";
                 cout << "6. View Patient Info\n";
+                cout << "7. Remove Patient\n";
                 cout << "0. Back to Main Menu\n";
                 cout << "\n-> Enter your choice: ";
                 cin >> patientChoice;
@@ -705,22 +3692,27 @@ void run(Hospital &hospital)
                     cin.ignore();
                     getline(cin, contact);
                     int id = hospital.registerPatient(name, age, contact);
-                    cout << "Patient registered with ID: " << id << endl;
+                    if (id > 0)
+                    {
+                        cout << "Patient registered with ID: " << id << endl;
+                    }
                     break;
                 }
                 case 2:
                 {
                     int id, room;
+                    RoomType type;
                     cout << "Enter patient ID: ";
                     cin >> id;
-                    cout << "0. General\n1. ICU\n2. Private\n3. Semi-Private\nRoom type: ";
+                    EnumTable<RoomType>::printMenu();
+                    cout << "Room type: ";
                     cin >> room;
-                    if (room < 0 || room > 3)
+                    if (!EnumTable<RoomType>::fromMenu(room, type))
                     {
                         cout << "ERROR: Invalid room type.\n";
                         break;
                     }
-                    hospital.admitPatient(id, static_cast<RoomType>(room));
+                    hospital.admitPatient(id, type);
                     hospital.savePatients();
                     break;
                 }
@@ -747,20 +3739,26 @@ void run(Hospital &hospital)
                     break;
                 }
                 case 5:
+                {
+                    hospital.displayLabStats();
+                    break;
+                }
+                case 6:
                 {
                     int id;
                     cout << "Enter patient ID: ";
                     cin >> id;
-                    hospital.performTest(id);
-                    hospital.savePatients();
+                    hospital.displayPatientInfo(id);
                     break;
                 }
-                case 6:
+                case 7:
                 {
                     int id;
                     cout << "Enter patient ID: ";
                     cin >> id;
-                    hospital.displayPatientInfo(id);
+                    hospital.removePatient(id);
+                    hospital.savePatients();
+                    hospital.saveDoctors(); // Their appointments were cancelled
                     break;
                 }
                 }
@@ -778,6 +3776,7 @@ void run(Hospital &hospital)
                 cout << "2. Book Appointment\n";
                 cout << "3. View Doctor Info\n";
                 cout << "4. See Next Patient\n";
+                cout << "5. View Busiest Doctors\n";
                 cout << "0. Back to Main Menu\n";
                 cout << "\n-> Enter your choice: ";
                 cin >> doctorChoice;
@@ -789,18 +3788,23 @@ void run(Hospital &hospital)
                 {
                     string name;
                     int dept;
+                    Department department;
                     cout << "Enter doctor's name (Dr. Name): ";
                     cin.ignore();
                     getline(cin, name);
-                    cout << "0. Cardiology\n1. Neurology\n2. Orthopedics\n3. Pediatrics\n4. Emergency\n5. General\nDepartment: ";
+                    EnumTable<Department>::printMenu();
+                    cout << "Department: ";
                     cin >> dept;
-                    if (dept < 0 || dept > 5)
+                    if (!EnumTable<Department>::fromMenu(dept, department))
                     {
                         cout << "ERROR: Invalid department.\n";
                         break;
                     }
-                    int id = hospital.addDoctor(name, static_cast<Department>(dept));
-                    cout << "Doctor added with ID: " << id << endl;
+                    int id = hospital.addDoctor(name, department);
+                    if (id > 0)
+                    {
+                        cout << "Doctor added with ID: " << id << endl;
+                    }
                     break;
                 }
                 case 2:
@@ -830,6 +3834,11 @@ void run(Hospital &hospital)
                     hospital.saveDoctors(); // To Save Updated Count
                     break;
                 }
+                case 5:
+                {
+                    hospital.displayBusiestDoctors(10);
+                    break;
+                }
                 }
             } while (doctorChoice != 0);
             break;
@@ -868,6 +3877,51 @@ void run(Hospital &hospital)
             break;
         }
 
+        case 4: // Time-Travel Query
+        {
+            string dateTime;
+            cout << "\nEnter date and time (YYYY-MM-DD HH:MM:SS): ";
+            cin.ignore();
+            getline(cin, dateTime);
+            EventReplay(EVENT_FILE, CHECKPOINT_FILE).displayStateAt(dateTime);
+            break;
+        }
+
+        case 5: // Export Data
+        {
+            int format;
+            cout << "\n0. JSON Lines (hospital_export.jsonl)\n1. Columnar (export_*.col)\nFormat: ";
+            cin >> format;
+            DataExporter exporter;
+            if (format == 0)
+            {
+                if (exporter.exportJsonLines(hospital, "hospital_export.jsonl"))
+                {
+                    exporter.displayStats("JSON lines");
+                }
+                else
+                {
+                    cout << "ERROR: Export failed.\n";
+                }
+            }
+            else if (format == 1)
+            {
+                if (exporter.exportColumnar(hospital, "export_"))
+                {
+                    exporter.displayStats("columnar tables");
+                }
+                else
+                {
+                    cout << "ERROR: Export failed.\n";
+                }
+            }
+            else
+            {
+                cout << "ERROR: Invalid format.\n";
+            }
+            break;
+        }
+
         case 0:
             cout << "Exiting system. Saving data...\n";
             hospital.savePatients();
@@ -884,7 +3938,10 @@ void run(Hospital &hospital)
 // ========== MAIN PROGRAM ========== //
 int main()
 {
+    auto start = chrono::steady_clock::now();
     Hospital hospital;
+    cout << "Ready in " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms ("
+         << hospital.getPatientCount() << " patients, " << hospital.getLoadedPatientCount() << " loaded)\n";
     run(hospital);
     return 0;
 }
\ No newline at end of file